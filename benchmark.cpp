@@ -0,0 +1,535 @@
+// clang++ -O2 benchmark.cpp -lsdl2 -lsdl2_ttf -lsdl2_image -lsdl2_mixer
+// headless benchmark, run it in the repo directory:
+//
+//     ./a.out [filter]
+//
+// it use the dummy video driver and the software renderer, so no display needed.
+// every case print a json line to stdout:
+//     {"case": "render_copy", "n": 10000, "samples": 10, "ops_per_sec": ..., "p50_ms": ..., "p99_ms": ...}
+// ops_per_sec count ops (sprites, texts, loads...), p50 / p99 are milliseconds of one sample (n ops).
+
+#include "sdlapp2.hpp"
+
+#include <algorithm>
+#include <functional>
+
+
+// sprite as virtual entity, to compare with sdl_entity_array_t
+class sprite_entity_t : public sdl_entity_t {
+public:
+    float w, h, vx, vy;
+    SDL_Texture* texture;
+    sdl_sprite_batch_t* batch;
+
+    sprite_entity_t(SDL_FRect rect, SDL_Texture* texture, sdl_sprite_batch_t* batch)
+    : sdl_entity_t(rect.x, rect.y), w(rect.w), h(rect.h), vx(1.0f), vy(0.5f), texture(texture), batch(batch) {}
+
+    virtual void update(float dt) {
+        x += vx * dt;
+        y += vy * dt;
+    }
+
+    SDL_FRect get_bounds() const {
+        return {x, y, w, h};
+    }
+
+    void render(render_info_t& info) const {
+        if (x > info.w_width || y > info.w_height || x + w < 0 || y + h < 0) {
+            return;
+        }
+        batch->draw(texture, SDL_FRect{x, y, w, h});
+    }
+};
+
+
+
+class benchmark_t : public sdl_window_t {
+public:
+    // == resources ==
+
+    sdl_font_t font{"PixelMplus10-Regular.ttf", 24};
+    sdl_texture_t sprite{this};
+
+    std::string filter;
+    int samples = 10;
+    int event_count = 0;
+    int user_count = 0;
+
+    sdl_entity_manager_t* scene = nullptr;      // drawn by on_render() when set
+    sdl_sprite_batch_t scene_batch;
+
+
+
+    // == setup ==
+
+    void on_setup() {
+        init_info_t info;
+        info.sdl_flags = SDL_INIT_VIDEO | SDL_INIT_EVENTS;
+        info.mixer_flags = 0;
+        init_sdl(info);
+
+        info.wnd_title = "benchmark";
+        info.wnd_size = {800, 600};
+        info.wnd_flags = SDL_WINDOW_HIDDEN;
+        info.rnd_flags = SDL_RENDERER_SOFTWARE;
+        init_window(info);
+
+        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, 32, 32, 32, SDL_PIXELFORMAT_ARGB8888);
+        SDL_FillRect(surface, nullptr, 0xffffcc00);
+        sprite = sdl_texture_t(this, sdl_surface_t(surface));
+        SDL_SetTextureBlendMode(sprite, SDL_BLENDMODE_BLEND);
+    }
+
+    void on_render(sdl_tick_t tick) {
+        if (scene) {
+            render_clear(renderer);
+            scene->render(tick);
+            scene_batch.flush(renderer);
+        }
+    }
+
+    void on_event(SDL_Event& e) {
+        event_count++;
+        user_count += e.type == SDL_USEREVENT;
+    }
+
+
+
+    // == helper ==
+
+    // deterministic position of i-th sprite
+    SDL_FRect get_rect(int i) const {
+        uint32_t h = (uint32_t) i * 2654435761u;
+        return {(float) (h % window_width), (float) ((h >> 12) % window_height), 16.0f, 16.0f};
+    }
+
+    static double get_ms(uint64_t begin, uint64_t end) {
+        return (double) (end - begin) * 1000.0 / (double) SDL_GetPerformanceFrequency();
+    }
+
+    // run func (which do n ops) once for warm up and samples times for measure, return ops_per_sec or 0 if filtered
+    double measure(const char* name, int n, const std::function<void()>& func) {
+        std::string id = std::string(name) + "/" + std::to_string(n);
+        if (filter.empty() == false && id.find(filter) == std::string::npos) {
+            return 0.0;
+        }
+
+        func();
+
+        std::vector<double> times;
+        for (int i = 0; i < samples; i++) {
+            uint64_t begin = SDL_GetPerformanceCounter();
+            func();
+            times.push_back(get_ms(begin, SDL_GetPerformanceCounter()));
+        }
+
+        double total = 0.0;
+        for (double t : times) {
+            total += t;
+        }
+        std::sort(times.begin(), times.end());
+
+        double ops_per_sec = (double) n * samples * 1000.0 / total;
+        printf("{\"case\": \"%s\", \"n\": %d, \"samples\": %d, \"ops_per_sec\": %.1f, \"p50_ms\": %.4f, \"p99_ms\": %.4f}\n",
+                    name, n, samples,
+                    ops_per_sec,
+                    times[times.size() / 2],
+                    times[(size_t) ((times.size() - 1) * 0.99)]
+        );
+        fflush(stdout);
+        return ops_per_sec;
+    }
+
+
+
+    // == cases ==
+
+    void bench_sprites() {
+        for (int count : {10000, 30000, 100000}) {
+            measure("render_copy", count, [&]() {
+                render_clear(renderer);
+                for (int i = 0; i < count; i++) {
+                    SDL_FRect rect = get_rect(i);
+                    render_copy(renderer, sprite, nullptr, &rect, (double) (i % 360));
+                }
+                SDL_RenderPresent(renderer);
+            });
+
+            sdl_sprite_batch_t batch;
+            measure("sprite_batch", count, [&]() {
+                render_clear(renderer);
+                for (int i = 0; i < count; i++) {
+                    batch.draw(sprite, nullptr, get_rect(i), (double) (i % 360));
+                }
+                batch.flush(renderer);
+                SDL_RenderPresent(renderer);
+            });
+        }
+    }
+
+    // update and submit only, the batch is cleared without drawing
+    void bench_entities() {
+        for (int count : {10000, 100000, 1000000}) {
+            sdl_sprite_batch_t batch;
+
+            {
+                std::vector<std::unique_ptr<sprite_entity_t>> entities;
+                for (int i = 0; i < count; i++) {
+                    entities.emplace_back(new sprite_entity_t(get_rect(i), sprite, &batch));
+                }
+                sdl_entity_t::render_info_t info{renderer, window_width, window_height, 0};
+
+                measure("entity_virtual", count, [&]() {
+                    for (auto& entity : entities) {
+                        entity->update(0.016f);
+                    }
+                    for (auto& entity : entities) {
+                        entity->render(info);
+                    }
+                    batch.clear();
+                });
+            }
+
+            {
+                sdl_entity_array_t entities;
+                uint16_t texture = entities.add_texture(sprite);
+                entities.reserve(count);
+                for (int i = 0; i < count; i++) {
+                    int index = entities.create(get_rect(i), texture);
+                    entities.vx[index] = 1.0f;
+                    entities.vy[index] = 0.5f;
+                }
+                SDL_FRect view{0.0f, 0.0f, (float) window_width, (float) window_height};
+
+                measure("entity_array", count, [&]() {
+                    entities.update(0.016f);
+                    entities.render(batch, view);
+                    batch.clear();
+                });
+
+                // same update split by the job system
+                measure("entity_array_jobs", count, [&]() {
+                    jobs.parallel_for(0, entities.get_count(), [&](int begin, int end) {
+                        for (int i = begin; i < end; i++) {
+                            entities.x[i] += entities.vx[i] * 0.016f;
+                            entities.y[i] += entities.vy[i] * 0.016f;
+                        }
+                    });
+                    entities.render(batch, view);
+                    batch.clear();
+                });
+            }
+        }
+    }
+
+    // a mostly static dashboard, one small widget change every frame
+    void bench_redraw() {
+        const int frames = 20;
+
+        sdl_entity_manager_t entities{this};
+        for (int i = 0; i < 10000; i++) {
+            entities.create<sprite_entity_t>(get_rect(i), sprite, &scene_batch);
+        }
+        scene = &entities;
+
+        measure("redraw_full", frames, [&]() {
+            for (int i = 0; i < frames; i++) {
+                post_redraw();
+                render_frame(0, 1.0f);
+            }
+        });
+
+        // the scene retained in a layer, composited by one copy
+        sdl_layer_t layer{this};
+        measure("redraw_layer", frames, [&]() {
+            for (int i = 0; i < frames; i++) {
+                render_clear(renderer);
+                layer.render([&]() {
+                    entities.render(0);
+                    scene_batch.flush(renderer);
+                });
+                SDL_RenderPresent(renderer);
+            }
+        });
+
+        enable_partial_redraw();
+        render_frame(0, 1.0f);
+
+        measure("redraw_partial", frames, [&]() {
+            for (int i = 0; i < frames; i++) {
+                post_redraw(SDL_Rect{16 + i * 8, 16, 64, 32});
+                render_frame(0, 1.0f);
+            }
+        });
+
+        render_partial = false;
+        render_lazy_draw = false;
+        scene = nullptr;
+    }
+
+    void bench_text() {
+        const int count = 100;
+
+        measure("text_surface", count, [&]() {
+            for (int i = 0; i < count; i++) {
+                sdl_surface_t surface(font, "score: " + std::to_string(i * 7919), SDLAPP_TEXT_BLENDED);
+                surface.load();
+            }
+        });
+
+        measure("text_texture", count, [&]() {
+            for (int i = 0; i < count; i++) {
+                sdl_texture_t texture(this, font, "score: " + std::to_string(i * 7919), SDLAPP_TEXT_BLENDED);
+                texture.load();
+            }
+        });
+
+        // request all and pump the uploads like frames do, until every text is ready
+        sdl_text_pipeline_t texts{this, count};
+        measure("text_pipeline", count, [&]() {
+            std::vector<sdl_texture_t> textures;
+            for (int i = 0; i < count; i++) {
+                textures.push_back(texts.request(font, "score: " + std::to_string(i * 7919)));
+            }
+            while (texts.has_pending()) {
+                texts.on_frame(0);
+                SDL_Delay(0);
+            }
+        });
+
+        sdl_glyph_cache_t glyphs{this};
+        measure("text_glyph_cache", count, [&]() {
+            for (int i = 0; i < count; i++) {
+                glyphs.render(renderer, font, "score: " + std::to_string(i * 7919), 0.0f, 0.0f);
+            }
+        });
+    }
+
+    void bench_resources() {
+        const int count = 20;
+
+        measure("texture_load", count, [&]() {
+            for (int i = 0; i < count; i++) {
+                sdl_texture_t texture(this, "titi.png");
+                texture.load();
+            }
+        });
+
+        // first run (warm up) save the decoded pixels, the others upload them from the mapped cache
+        sdl_pixel_cache().enable(".");
+        measure("texture_load_cached", count, [&]() {
+            for (int i = 0; i < count; i++) {
+                sdl_texture_t texture(this, "titi.png");
+                texture.load();
+            }
+        });
+        sdl_pixel_cache().disable();
+        remove(sdl_pixel_cache().get_cache_file("titi.png").c_str());
+
+        const int churn = 100000;
+        sdl_texture_t texture(this, "titi.png");
+        texture.load();
+
+        measure("resource_churn", churn, [&]() {
+            sdl_texture_t other(this);
+            for (int i = 0; i < churn; i++) {
+                sdl_texture_t copy(texture);
+                other = copy;
+            }
+        });
+
+        // every text different, texts are not interned so they should not grow the string table
+        std::vector<std::string> texts;
+        for (int i = 0; i < churn; i++) {
+            texts.push_back("churn " + std::to_string(i));
+        }
+
+        sdl_pool_t::stats_t before = sdl_pool_stats();
+        measure("resource_create", churn, [&]() {
+            for (int i = 0; i < churn; i++) {
+                sdl_surface_t surface(font, texts[i]);
+            }
+        });
+        sdl_pool_t::stats_t after = sdl_pool_stats();
+
+        // infos come from sdl_pool(), steady creation should not reach the system allocator
+        printf("{\"case\": \"pool\", \"system_allocs\": %llu, \"live\": %llu, \"string_allocs\": %llu}\n",
+                    (unsigned long long) (after.system_allocs - before.system_allocs),
+                    (unsigned long long) after.live,
+                    (unsigned long long) (after.string_allocs - before.string_allocs)
+        );
+    }
+
+    // cold loading of the assets, from loose files and from a mounted pack of them
+    void bench_startup() {
+        const int count = 10;
+        const char* pack = "benchmark.pack";
+
+        auto load_all = [&]() {
+            sdl_texture_t texture(this, "titi.png");
+            texture.load();
+            sdl_font_t other("PixelMplus10-Regular.ttf", 24);
+            other.load();
+        };
+
+        sdl_pack_t::build(pack, {"titi.png", "PixelMplus10-Regular.ttf"});
+
+        measure("startup_loose", count, [&]() {
+            for (int i = 0; i < count; i++) {
+                load_all();
+            }
+        });
+
+        measure("startup_pack", count, [&]() {
+            for (int i = 0; i < count; i++) {
+                sdl_packs().mount(pack);
+                load_all();
+                sdl_packs().unmount(pack);
+            }
+        });
+
+        remove(pack);
+    }
+
+    void bench_events() {
+        const int count = 1000;
+
+        measure("event_dispatch", count, [&]() {
+            SDL_Event e;
+            SDL_zero(e);
+            e.type = SDL_USEREVENT;
+            for (int i = 0; i < count; i++) {
+                SDL_PushEvent(&e);
+            }
+
+            event_count = 0;
+            while (event_count < count) {
+                wait_events(0);
+            }
+        });
+
+        // a high polling rate mouse, motions between user events are merged into one
+        int dispatched = 0;
+        measure("event_motion", count, [&]() {
+            SDL_Event e;
+            SDL_zero(e);
+            e.type = SDL_MOUSEMOTION;
+            for (int i = 0; i < count; i++) {
+                e.motion.x = i % window_width;
+                e.motion.xrel = 1;
+                SDL_PushEvent(&e);
+            }
+            e.type = SDL_USEREVENT;
+            SDL_PushEvent(&e);
+
+            event_count = 0;
+            user_count = 0;
+            while (user_count == 0) {
+                wait_events(0);
+            }
+            dispatched = event_count;
+        });
+        printf("{\"case\": \"event_motion_dispatched\", \"n\": %d, \"dispatched\": %d}\n", count, dispatched);
+    }
+
+    // voices mixed by sdl_soft_mixer_t into a s16 stereo stream, no audio device needed.
+    // a op is one voice mixed for one chunk, half of the voices are resampled.
+    void bench_soft_mixer() {
+        const int voices = 256;
+        const int frequency = 48000;
+        const int chunk = 1024;
+        const int chunks = 8;
+
+        std::vector<float> noise(frequency * 2);
+        uint32_t seed = 1;
+        for (float& v : noise) {
+            seed = seed * 1664525 + 1013904223;
+            v = (int32_t) seed * (0.25f / 2147483648.0f);
+        }
+        auto sound = std::make_shared<sdl_soft_mixer_t::sound_t>(noise.data(), frequency, 2, frequency);
+        auto sound_44k = std::make_shared<sdl_soft_mixer_t::sound_t>(noise.data(), 44100, 2, 44100);
+
+        std::vector<uint8_t> stream(chunk * 2 * sizeof(int16_t));
+
+        const sdl_soft_mixer_t::kernel_t kernels[] = {
+            sdl_soft_mixer_t::KERNEL_SCALAR, sdl_soft_mixer_t::KERNEL_SSE2, sdl_soft_mixer_t::KERNEL_AVX2,
+        };
+        for (sdl_soft_mixer_t::kernel_t kernel : kernels) {
+            sdl_soft_mixer_t mixer(voices);
+            mixer.set_format(frequency, AUDIO_S16SYS, 2, chunk);
+            mixer.set_kernel(kernel);
+            if (mixer.get_kernel() != kernel) {
+                continue;       // not supported by this cpu
+            }
+
+            for (int i = 0; i < voices; i++) {
+                if (i % 2 == 0) {
+                    mixer.play(sound, 0.05f, (i % 9 - 4) / 4.0f, 1.0f, true);
+                }
+                else {
+                    mixer.play(sound_44k, 0.05f, (i % 9 - 4) / 4.0f, 0.5f + (i % 16) / 16.0f, true);
+                }
+            }
+
+            std::string name = std::string("soft_mixer_") + mixer.get_kernel_name();
+            double ops_per_sec = measure(name.c_str(), voices * chunks, [&]() {
+                for (int i = 0; i < chunks; i++) {
+                    std::fill(stream.begin(), stream.end(), 0);
+                    mixer.process(stream.data(), (int) stream.size());
+                }
+            });
+            if (ops_per_sec == 0.0) {
+                continue;
+            }
+
+            // voices one core could keep mixing in real time
+            printf("{\"case\": \"soft_mixer\", \"kernel\": \"%s\", \"voices_per_ms\": %.2f, \"realtime_voices\": %.0f}\n",
+                        mixer.get_kernel_name(), ops_per_sec / 1000.0, ops_per_sec * chunk / frequency);
+        }
+    }
+
+    // time of each subsystem init done by on_setup(), in order
+    void bench_init() {
+        if (filter.empty() == false && std::string("init").find(filter) == std::string::npos) {
+            return;
+        }
+
+        printf("{\"case\": \"init\", \"total_ms\": %.3f", sdl_subsystems().get_total_ms());
+        for (const sdl_subsystems_t::timing_t& timing : sdl_subsystems().get_timings()) {
+            printf(", \"%s_ms\": %.3f", timing.name, timing.ms);
+        }
+        printf("}\n");
+    }
+
+
+    void run_all() {
+        try {
+            on_setup();
+
+            bench_init();
+            bench_sprites();
+            bench_entities();
+            bench_redraw();
+            bench_text();
+            bench_resources();
+            bench_startup();
+            bench_events();
+            bench_soft_mixer();
+        }
+        catch (sdl_exception_t& e) {
+            std::cerr << e.what() << "\n";
+        }
+    }
+};
+
+
+int main(int argc, char** argv) {
+    SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+
+    benchmark_t benchmark;
+    if (argc > 1) {
+        benchmark.filter = argv[1];
+    }
+    benchmark.run_all();
+    return 0;
+}
@@ -21,6 +21,8 @@ public:
     
     sdl_texture_t img_empty{this};        // empty texture targeted to "".
     
+    sdl_layer_t layer_background{this};   // static content drawn once, then copied every frame until invalidate() or resized.
+
 
 
     sdl_music_t music_the_world{"the-world!!!.mp3"};    // music resource load from file.
@@ -36,6 +38,7 @@ public:
         init_info_t info;
 
         info.mixer_flags = 0;
+        // info.lazy_init = true;        // init ttf, image and mixer the first time one is loaded
         init_sdl(info);
 
         info.wnd_title = "hello world";
@@ -45,6 +48,7 @@ public:
 
         disable_update();
         // enable_lazy_draw();
+        // enable_adaptive_pacing();      // render at display refresh rate, stop rendering while nothing changed
     }
 
     // callback when getting event.
@@ -82,16 +86,21 @@ public:
     // if you want to render only when event happen, put enable_lazy_draw() to on_setup() and call send_redraw_signal() when you want to redraw window, it will better performance for simply app.
     // you can control fps by set_render_delay(1000 / fps)
     void on_render(sdl_tick_t tick) {
-        SDL_FRect rect;
+        if (layer_background.begin()) {
+            SDL_FRect rect;
+
+            rect = {0, 0, (float) window_width, (float) window_height};
+            render_copy(renderer, img_titi, nullptr, &rect);
 
-        rect = {0, 0, (float) window_width, (float) window_height};
-        render_copy(renderer, img_titi, nullptr, &rect);
+            rect.w = window_width * 0.9f;
+            rect.h = (float) img_text_hello_world.get_height() * (float) window_width / (float) img_text_hello_world.get_width();
+            rect.x = ((float) window_width - rect.w) * 0.5f;
+            rect.y = ((float) window_height - rect.h) * 0.3f;
+            render_copy(renderer, img_text_hello_world, nullptr, &rect);
 
-        rect.w = window_width * 0.9f;
-        rect.h = (float) img_text_hello_world.get_height() * (float) window_width / (float) img_text_hello_world.get_width();
-        rect.x = ((float) window_width - rect.w) * 0.5f;
-        rect.y = ((float) window_height - rect.h) * 0.3f;
-        render_copy(renderer, img_text_hello_world, nullptr, &rect);
+            layer_background.end();
+        }
+        layer_background.render();
     }
 };
 
@@ -18,6 +18,16 @@
 #include <iostream>
 #include <exception>
 #include <vector>
+#include <deque>
+#include <cmath>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+#include <memory>
+#include <list>
+#include <atomic>
+#include <functional>
+#include <cstring>
 
 
 
@@ -33,6 +43,8 @@
 #define _CODE_IN_MSVC(code) code
 #define _CODE_NOT_MSVC(code)
 
+#include <intrin.h>
+
 #else
 
 #define _CODE_IN_MSVC(code)
@@ -41,6 +53,45 @@
 #endif
 
 
+// os apis of mapped files, stat and mkdir, by the platform rather than the compiler
+
+#if defined(_WIN32)
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <direct.h>
+
+#else
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#endif
+
+
+// simd kernels are built for their instruction set whatever the compiler flags, and picked at runtime
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define _SDLAPP_X86
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#define _TARGET_ISA(isa)
+#else
+#define _TARGET_ISA(isa) __attribute__((target(isa)))
+#endif
+
+
 
 // == sdl_exeception_t ==
 
@@ -94,6 +145,19 @@ constexpr SDL_Color SDLAPP_COLOR_PURPLE{128, 0, 128, 255};
 
 
 
+// == compare ==
+
+constexpr bool operator==(const SDL_Color a, const SDL_Color b) {
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+constexpr bool operator!=(const SDL_Color a, const SDL_Color b) {
+    return !(a == b);
+}
+
+
+
+
 // == ostream ==
 
 std::ostream& operator<<(std::ostream& os, const SDL_Rect rect) {
@@ -135,6 +199,9 @@ std::ostream& operator<<(std::ostream& os, const SDL_Color color) {
 
 // == basic ==
 
+class sdl_atlas_t;
+class sdl_sub_texture_t;
+
 class sdl_basic_t {
 protected:
     class render_info_t {
@@ -147,7 +214,19 @@ protected:
 
     // == render ==
 
+    // SDL_RenderClear() ignores the clip rect, so fill the clip rect instead while clipping
     inline static int render_clear(SDL_Renderer* renderer) {
+        if (SDL_RenderIsClipEnabled(renderer)) {
+            SDL_Rect clip;
+            SDL_BlendMode mode;
+            SDL_RenderGetClipRect(renderer, &clip);
+            SDL_GetRenderDrawBlendMode(renderer, &mode);
+
+            SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+            int ret = SDL_RenderFillRect(renderer, &clip);
+            SDL_SetRenderDrawBlendMode(renderer, mode);
+            return ret;
+        }
         return SDL_RenderClear(renderer);
     }
 
@@ -159,6 +238,13 @@ protected:
         return SDL_RenderCopyExF(renderer, texture, src_rect, dest_rect, angle, center, flip);
     }
 
+    // src_rect is relative to the sub texture
+    inline static int render_copy(SDL_Renderer* renderer, const sdl_sub_texture_t& texture,
+                const SDL_Rect* src_rect = nullptr, const SDL_FRect* dest_rect = nullptr,
+                double angle = 0.0, const SDL_FPoint* center = nullptr,
+                SDL_RendererFlip flip = SDL_FLIP_NONE
+    );
+
 
     inline static int render_fill_rect(SDL_Renderer* renderer, SDL_FRect* rect = nullptr) {
         return SDL_RenderFillRectF(renderer, rect);
@@ -231,943 +317,7328 @@ protected:
 };
 
 
-// == sdl_window_t ==
+// == sprite batch ==
 
+// collect sprites and draw them by one SDL_RenderGeometry() per texture instead of SDL_RenderCopyExF() per sprite.
+// sprites of same texture keep their order, textures are drawn in order of first use,
+// so overlapped sprites of different textures may not be ordered as render_copy() does.
+// buffers are kept between frames, so steady drawing don't allocate.
+class sdl_sprite_batch_t {
+    class bucket_t {
+    public:
+        SDL_Texture* texture;
+        float inv_width = 0.0f;
+        float inv_height = 0.0f;
+        std::vector<SDL_Vertex> vertices;
+    };
 
-class sdl_window_t : public sdl_basic_t {
-    friend class sdl_texture_t;
-    friend class sdl_font_t;
+    std::vector<bucket_t> buckets;
+    std::vector<int> indices;           // same quad pattern for all buckets
+    size_t last = 0;
+    int sprite_count = 0;
 
 
-protected:
-    // == running variables ==
 
-    bool running = true;
-    SDL_Window* window = nullptr;
-    SDL_Renderer* renderer = nullptr;
+    bucket_t& get_bucket(SDL_Texture* texture) {
+        if (last < buckets.size() && buckets[last].texture == texture) {
+            return buckets[last];
+        }
 
-    int window_width = 0;
-    int window_height = 0;
+        for (last = 0; last < buckets.size(); last++) {
+            if (buckets[last].texture == texture) {
+                break;
+            }
+        }
+        if (last == buckets.size()) {
+            buckets.emplace_back();
+            buckets[last].texture = texture;
+        }
+        return buckets[last];
+    }
 
+    void grow_indices(size_t quads) {
+        size_t i = indices.size() / 6;
+        if (i >= quads) {
+            return;
+        }
 
-    SDL_Event event;
+        indices.resize(quads * 6);
+        for (; i < quads; i++) {
+            int base = (int) i * 4;
+            int* p = &indices[i * 6];
+            p[0] = base;
+            p[1] = base + 1;
+            p[2] = base + 2;
+            p[3] = base + 2;
+            p[4] = base + 3;
+            p[5] = base;
+        }
+    }
 
-    uint32_t update_delay = 50;
-    uint32_t next_update_time = 0;
 
-    uint32_t render_delay = 15;
-    uint32_t next_render_time = 0;
-    bool render_lazy_draw = false;
+public:
+    // == draw ==
+
+    // same meaning as sdl_basic_t::render_copy(), color is multiplied to the texture.
+    void draw(SDL_Texture* texture, const SDL_Rect* src_rect, const SDL_FRect& dest_rect,
+                double angle = 0.0, const SDL_FPoint* center = nullptr,
+                SDL_RendererFlip flip = SDL_FLIP_NONE, SDL_Color color = SDLAPP_COLOR_WHITE
+    ) {
+        if (texture == nullptr) {
+            return;
+        }
 
-    std::vector<SDL_Thread*> threads{16};
-    int thread_count = 0;
+        bucket_t& bucket = get_bucket(texture);
 
+        if (bucket.vertices.empty()) {
+            // query once per frame, the pointer may be reused by another texture after destroy
+            int w = 0, h = 0;
+            SDL_QueryTexture(texture, nullptr, nullptr, &w, &h);
+            bucket.inv_width = w ? 1.0f / (float) w : 0.0f;
+            bucket.inv_height = h ? 1.0f / (float) h : 0.0f;
+        }
 
+        float u0 = 0.0f, v0 = 0.0f, u1 = 1.0f, v1 = 1.0f;
+        if (src_rect) {
+            u0 = (float) src_rect->x * bucket.inv_width;
+            v0 = (float) src_rect->y * bucket.inv_height;
+            u1 = (float) (src_rect->x + src_rect->w) * bucket.inv_width;
+            v1 = (float) (src_rect->y + src_rect->h) * bucket.inv_height;
+        }
+        if (flip & SDL_FLIP_HORIZONTAL) {
+            std::swap(u0, u1);
+        }
+        if (flip & SDL_FLIP_VERTICAL) {
+            std::swap(v0, v1);
+        }
 
+        float x[4] = {0.0f, dest_rect.w, dest_rect.w, 0.0f};
+        float y[4] = {0.0f, 0.0f, dest_rect.h, dest_rect.h};
 
-    virtual void on_setup() {
-        init_info_t info;
-        init_sdl(info);
-        init_window(info);
-    }
+        if (angle != 0.0) {
+            float cx = center ? center->x : dest_rect.w * 0.5f;
+            float cy = center ? center->y : dest_rect.h * 0.5f;
+            float rad = (float) (angle * M_PI / 180.0);
+            float c = std::cos(rad), s = std::sin(rad);
 
-    virtual void on_event(SDL_Event& e) {
-        switch (e.type) {
-            case SDL_QUIT:
-                post_stop();
-                return;
-            case SDL_WINDOWEVENT:
-                switch (e.window.event) {
-                    case SDL_WINDOWEVENT_SIZE_CHANGED:
-                        window_width = e.window.data1;
-                        window_height = e.window.data2;
-                        post_redraw();
-                        return;
-                }
-            case SDL_MOUSEWHEEL:
-            case SDL_KEYDOWN:
-            case SDL_KEYUP:
-            case SDL_MOUSEBUTTONDOWN:
-            case SDL_MOUSEBUTTONUP:
-            case SDL_MOUSEMOTION:
-                post_redraw();
-                return;
+            for (int i = 0; i < 4; i++) {
+                float dx = x[i] - cx, dy = y[i] - cy;
+                x[i] = cx + dx * c - dy * s;
+                y[i] = cy + dx * s + dy * c;
+            }
         }
-    }
 
-    virtual void on_update(sdl_tick_t tick) {
-        
+        bucket.vertices.push_back({{dest_rect.x + x[0], dest_rect.y + y[0]}, color, {u0, v0}});
+        bucket.vertices.push_back({{dest_rect.x + x[1], dest_rect.y + y[1]}, color, {u1, v0}});
+        bucket.vertices.push_back({{dest_rect.x + x[2], dest_rect.y + y[2]}, color, {u1, v1}});
+        bucket.vertices.push_back({{dest_rect.x + x[3], dest_rect.y + y[3]}, color, {u0, v1}});
+        sprite_count++;
     }
 
-    virtual void on_render(sdl_tick_t tick) {
-        
+    void draw(SDL_Texture* texture, const SDL_FRect& dest_rect, SDL_Color color = SDLAPP_COLOR_WHITE) {
+        draw(texture, nullptr, dest_rect, 0.0, nullptr, SDL_FLIP_NONE, color);
     }
 
+    // src_rect is relative to the sub texture
+    void draw(const sdl_sub_texture_t& texture, const SDL_Rect* src_rect, const SDL_FRect& dest_rect,
+                double angle = 0.0, const SDL_FPoint* center = nullptr,
+                SDL_RendererFlip flip = SDL_FLIP_NONE, SDL_Color color = SDLAPP_COLOR_WHITE
+    );
 
 
+    // == flush ==
 
+    // draw all collected sprites, return 0 or the first error of SDL_RenderGeometry().
+    int flush(SDL_Renderer* renderer) {
+        int ret = 0;
+        size_t used = 0;
 
-    // == init ==
-
-    class init_info_t {
-    public:
-        uint32_t sdl_flags = SDL_INIT_EVERYTHING;
-        SDL_LogPriority log_priority = SDL_LOG_PRIORITY_INFO;
+        for (size_t i = 0; i < buckets.size(); i++) {
+            bucket_t& bucket = buckets[i];
+            if (bucket.vertices.empty()) {
+                continue;       // unused this frame, forget it
+            }
 
-        bool ttf_flags = true;
+            size_t quads = bucket.vertices.size() / 4;
+            grow_indices(quads);
 
-        int image_flags = 0x3f;
-        int mixer_flags = 0xff;
+            int r = SDL_RenderGeometry(renderer, bucket.texture,
+                        bucket.vertices.data(), (int) bucket.vertices.size(),
+                        indices.data(), (int) quads * 6
+            );
+            if (r != 0 && ret == 0) {
+                ret = r;
+            }
 
-        int      audio_frequency = MIX_DEFAULT_FREQUENCY;
-        uint16_t audio_format = MIX_DEFAULT_FORMAT;
-        int      audio_channels = MIX_DEFAULT_CHANNELS;
-        int      audio_chunk_size = 1024;
+            bucket.vertices.clear();
+            if (used != i) {
+                std::swap(buckets[used], bucket);
+            }
+            used++;
+        }
 
+        buckets.resize(used);
+        last = 0;
+        sprite_count = 0;
+        return ret;
+    }
 
+    void clear() {
+        for (bucket_t& bucket : buckets) {
+            bucket.vertices.clear();
+        }
+        sprite_count = 0;
+    }
 
-        const char*     wnd_title = "basic window";
-        SDL_Point       wnd_position = {SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED};
-        SDL_Point       wnd_size = {SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED};
-        SDL_WindowFlags wnd_flags = SDL_WINDOW_RESIZABLE;
-        const char*     wnd_icon = nullptr;
 
-        int rnd_index = -1;
-        int rnd_flags = SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC;
-    };
+    // == get ==
 
-    void init_sdl(init_info_t& info) {
-        if (SDL_Init(info.sdl_flags) != 0) {
-            throw sdl_exception_t("failed to init sdl");
-        }
-        if (info.log_priority) {
-            SDL_LogSetAllPriority(info.log_priority);
-        }
-        if (info.ttf_flags) {
-            if (TTF_Init() != 0) {
-                throw sdl_exception_t("failed to init ttf");
-            }
-        }
-        if (info.image_flags) {
-            IMG_Init(info.image_flags);
-        }
-        if (info.mixer_flags) {
-            Mix_Init(info.mixer_flags);
+    int get_sprite_count() const {
+        return sprite_count;
+    }
 
-            int ret = Mix_OpenAudio(info.audio_frequency, info.audio_format, info.audio_channels, info.audio_chunk_size);
-            if (ret != 0) {
-                throw sdl_exception_t("failed to open audio");
-            }
+    int get_texture_count() const {
+        int count = 0;
+        for (const bucket_t& bucket : buckets) {
+            count += bucket.vertices.empty() == false;
         }
+        return count;
     }
+};
 
 
-    void init_window(init_info_t& info) {
-        if (window) {
-            return;
-        }
 
-        window = SDL_CreateWindow(info.wnd_title,
-            info.wnd_position.x, info.wnd_position.y,
-            info.wnd_size.x, info.wnd_size.y,
-            info.wnd_flags
-        );
-        if (window == nullptr) {
-            throw sdl_exception_t("failed to create window since %s!", SDL_GetError());
-        }
 
-        SDL_GetWindowSize(window, &window_width, &window_height);
-        
-        if (info.wnd_icon) {
-            SDL_Surface* surface = IMG_Load(info.wnd_icon);
+// == profiler ==
 
-            if (surface == nullptr) {
-                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "failed to set window icon, %s", IMG_GetError());
-            }
-            else {
-                SDL_SetWindowIcon(window, surface);
-                SDL_FreeSurface(surface);
-            }
-        }
+// records timing zones into a lock-free ring buffer, any thread may record.
+// zones are only compiled when SDLAPP_PROFILE is defined before including this file,
+// otherwise SDLAPP_PROFILE_ZONE() is nothing and run() records nothing.
+//
+//     void on_update(sdl_tick_t tick) {
+//         SDLAPP_PROFILE_ZONE("physics");
+//         ...
+//     }
+//
+// sdl_window_t::run() records "event", "update", "render", "present" and "frame".
+class sdl_profiler_t {
+    class slot_t {
+    public:
+        std::atomic<uint64_t> seq{0};       // index + 1 when written, 0 while writing
+        const char* name = nullptr;
+        uint64_t begin = 0;
+        uint64_t end = 0;
+        unsigned long thread = 0;
+    };
 
-        if (info.rnd_flags) {
-            renderer = SDL_CreateRenderer(window, info.rnd_index, info.rnd_flags);
+    class record_t {
+    public:
+        const char* name;
+        uint64_t begin, end;
+        unsigned long thread;
+    };
 
-            if (renderer == nullptr) {
-                throw sdl_exception_t("failed to create renderer since %s!", SDL_GetError());
-            }
-        }
-    }
+    std::vector<slot_t> ring;
+    uint64_t mask;
+    std::atomic<uint64_t> head{0};
 
+    uint64_t origin;
+    double frequency;
+    std::string trace_file;
 
 
 
-    // == post ==
+    // copy the records now in ring, skip slots being written
+    void snapshot(std::vector<record_t>& out) const {
+        out.clear();
+        for (const slot_t& slot : ring) {
+            uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq == 0) {
+                continue;
+            }
 
-    inline void post_redraw() {
-        if (render_lazy_draw == true) {
-            next_render_time = 1;
+            record_t record{slot.name, slot.begin, slot.end, slot.thread};
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == seq) {
+                out.push_back(record);
+            }
         }
     }
 
-    inline void post_stop() {
-        running = false;
-    }
 
+public:
+    class stats_t {
+    public:
+        int count = 0;
+        double min = 0.0;       // milliseconds
+        double avg = 0.0;
+        double max = 0.0;
+        double p99 = 0.0;
+    };
 
 
-    // == create ==
+    // == init ==
 
-    SDL_Thread* create_thread(const char* name, SDL_ThreadFunction func, void* data) {
-        if (thread_count >= threads.max_size()) {
-            threads.resize(thread_count * 2);
-        }
+    sdl_profiler_t(int capacity_log2 = 16)
+    : ring((size_t) 1 << capacity_log2), mask(((uint64_t) 1 << capacity_log2) - 1),
+      origin(SDL_GetPerformanceCounter()), frequency((double) SDL_GetPerformanceFrequency()) {}
 
-        SDL_Thread* thread = SDL_CreateThread(func, name, data);
-        if (thread == nullptr) {
-            throw sdl_exception_t("failed to create thread since %s", SDL_GetError());
-        }
+    sdl_profiler_t(const sdl_profiler_t&) = delete;
+    sdl_profiler_t& operator=(const sdl_profiler_t&) = delete;
 
-        return threads[thread_count++] = thread;
-    }
 
+    // == record ==
 
-    // == set ==
+    // name must live as long as the profiler, such as a string literal
+    void record(const char* name, uint64_t begin, uint64_t end) {
+        uint64_t index = head.fetch_add(1, std::memory_order_relaxed);
+        slot_t& slot = ring[index & mask];
 
-    inline void set_update_delay(uint32_t delay) {
-        update_delay = delay;
+        slot.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name = name;
+        slot.begin = begin;
+        slot.end = end;
+        slot.thread = SDL_ThreadID();
+        slot.seq.store(index + 1, std::memory_order_release);
     }
 
-    inline void set_render_delay(uint32_t delay) {
-        render_delay = delay;
+    void clear() {
+        for (slot_t& slot : ring) {
+            slot.seq.store(0, std::memory_order_relaxed);
+        }
     }
 
 
+    // == get ==
 
-    inline void disable_update() {
-        update_delay = -1;
-        next_update_time = -1;
-    }
+    // stats of a zone over the records still in ring
+    stats_t get_stats(const char* name) const {
+        std::vector<record_t> records;
+        std::vector<double> times;
+        snapshot(records);
 
-    inline void enable_lazy_draw() {
-        render_lazy_draw = true;
-    }
+        for (const record_t& record : records) {
+            if (record.name == name || strcmp(record.name, name) == 0) {
+                times.push_back((double) (record.end - record.begin) * 1000.0 / frequency);
+            }
+        }
 
-    
+        stats_t stats;
+        if (times.empty()) {
+            return stats;
+        }
 
-public:
+        std::sort(times.begin(), times.end());
 
-    ~sdl_window_t() {
-        if (renderer != nullptr) {
-            SDL_DestroyRenderer(renderer);
-        }
-        if (window != nullptr) {
-            SDL_DestroyWindow(window);
+        double sum = 0.0;
+        for (double t : times) {
+            sum += t;
         }
 
-        Mix_Quit();
-        IMG_Quit();
-        TTF_Quit();
-        SDL_Quit();
+        stats.count = (int) times.size();
+        stats.min = times.front();
+        stats.max = times.back();
+        stats.avg = sum / times.size();
+        stats.p99 = times[(size_t) ((times.size() - 1) * 0.99)];
+        return stats;
     }
 
+    const std::string& get_trace_file() const {
+        return trace_file;
+    }
 
-    void run() {
-        try {
-            on_setup();
 
-            uint32_t now, next;
+    // == set ==
 
-            while (running) {
-                next = MIN(next_update_time, next_render_time);
+    // write a chrome trace (chrome://tracing, perfetto) to file when sdl_window_t::run() exit
+    void set_trace_file(const std::string& file) {
+        trace_file = file;
+    }
 
-                while (SDL_WaitEventTimeout(&event, next > (now = get_ticks()) ? next - now : 0)) {
-                    on_event(event);
-                    
-                    if (next_render_time != -1 || running == false) {
-                        break;
-                    }
-                }
 
-                now = get_ticks();
+    // == dump ==
 
-                // -- handle tick --
-                if (now >= next_update_time) {
-                    on_update(now);
-                    next_update_time = now + update_delay;
-                }
+    void dump(const std::string& file) const {
+        FILE* fp = fopen(file.c_str(), "w");
+        if (fp == nullptr) {
+            throw sdl_exception_t("failed to open trace file '%s'!", file.c_str());
+        }
 
-                // -- render --
-                if (render_lazy_draw == true) {
-                    if (next_render_time != -1) {
-                        on_render(now);
-                        SDL_RenderPresent(renderer);
-                        next_render_time = -1;
-                    }
-                    continue;
-                }
+        std::vector<record_t> records;
+        snapshot(records);
+
+        fprintf(fp, "{\"traceEvents\":[\n");
+        for (size_t i = 0; i < records.size(); i++) {
+            const record_t& record = records[i];
 
-                if (now >= next_render_time) {
-                    on_render(now);
-                    SDL_RenderPresent(renderer);
-                    next_render_time = now + render_delay;
+            fprintf(fp, "%s{\"name\":\"", i ? ",\n" : "");
+            for (const char* p = record.name; *p; p++) {
+                if (*p == '"' || *p == '\\') {
+                    fputc('\\', fp);
                 }
+                fputc(*p, fp);
             }
-
-            SDL_Log("app exit normally");
-        }
-        catch (sdl_exception_t& e) {
-            std::cerr << e.what() << "\n";
-        }
-        catch (std::exception& e) {
-            SDL_Log("std::exception: %s", e.what());
-        }
-
-        // == wait threads ==
-
-        for (int i = 0; i < thread_count; i++) {
-            SDL_WaitThread(threads[i], nullptr);
+            fprintf(fp, "\",\"ph\":\"X\",\"pid\":0,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}",
+                        record.thread,
+                        (double) (record.begin - origin) * 1e6 / frequency,
+                        (double) (record.end - record.begin) * 1e6 / frequency
+            );
         }
+        fprintf(fp, "\n]}\n");
+        fclose(fp);
     }
 };
 
 
+inline sdl_profiler_t& sdl_profiler() {
+    static sdl_profiler_t profiler;
+    return profiler;
+}
 
 
+// record the time from created to destroyed
+class sdl_profile_zone_t {
+    const char* name;
+    uint64_t begin;
 
-// == resources ==
-
-// base class for resources, such as texture, font, music, etc.
-// this class designed for private use only
-class sdl_resource_t {
-protected:
-    class basic_info_t {
-    public:
-        int load_method = 0;
-        std::string file;
-
-        void* resource = nullptr;
-        int use_count = 1;
-
-        virtual ~basic_info_t() {}
+public:
+    sdl_profile_zone_t(const char* name) : name(name), begin(SDL_GetPerformanceCounter()) {}
 
-        basic_info_t(void* resource = nullptr, int load_method = 0) : resource(resource), load_method(load_method) {}
-        basic_info_t(const std::string& file, int load_method = 0) : file(file), load_method(load_method) {}
-    };
+    ~sdl_profile_zone_t() {
+        sdl_profiler().record(name, begin, SDL_GetPerformanceCounter());
+    }
+};
 
-    using release_t = void (*)(void*);
 
-    basic_info_t* ptr;
+#ifdef SDLAPP_PROFILE
 
-    
+#define _SDLAPP_CONCAT2(a, b) a##b
+#define _SDLAPP_CONCAT(a, b) _SDLAPP_CONCAT2(a, b)
+#define SDLAPP_PROFILE_ZONE(name) sdl_profile_zone_t _SDLAPP_CONCAT(_sdlapp_zone_, __LINE__)(name)
 
-    // == delete / move ==
+#else
 
-    void _delete(release_t release) noexcept {
-        ptr->use_count--;
-        if (ptr->use_count == 0) {
-            if (has_loaded()) {
-                release(ptr->resource);
-            }
-            delete ptr;
-        }
-    }
+#define SDLAPP_PROFILE_ZONE(name)
 
-    void _move2(release_t release, const sdl_resource_t& other) noexcept {
-        _delete(release);
-        ptr = other.ptr;
-        ptr->use_count++;
-    }
+#endif
 
-    void _release(release_t release) const noexcept {
-        if (has_loaded()) {
-            release(ptr->resource);
-            ptr->resource = nullptr;
-        }
-    }
 
 
-    // == init ==
 
-    sdl_resource_t(basic_info_t* ptr)
-    : ptr(ptr) {}
 
-    // constexpr sdl_resource_t() {}
+// == jobs ==
 
+// counts unfinished jobs posted with it, it must live until they finished.
+// jobs posted after a group start when the group become done.
+class sdl_job_group_t {
+    friend class sdl_job_system_t;
 
+    SDL_SpinLock lock = 0;
+    std::atomic<int> count{0};
+    std::vector<void*> continuations;       // job_t* of sdl_job_system_t
 
 public:
-    // == copy1 / move1 ==
-
-    sdl_resource_t(const sdl_resource_t& other) noexcept : ptr(other.ptr) {
-        ptr->use_count++;
-    }
+    sdl_job_group_t() {}
 
-    sdl_resource_t(sdl_resource_t&& other) noexcept : ptr(other.ptr) {
-        ptr->use_count++;
-    }
+    sdl_job_group_t(const sdl_job_group_t&) = delete;
+    sdl_job_group_t& operator=(const sdl_job_group_t&) = delete;
 
 
-    // == get ==
+    // == get / is ==
 
-    const std::string& get_file_name() const {
-        return ptr->file;
+    inline int get_count() const {
+        return count.load(std::memory_order_acquire);
     }
 
-    // == has ==
-
-    bool has_loaded() const {
-        return ptr->resource != nullptr;
+    inline bool is_done() const {
+        return get_count() == 0;
     }
-
-    // == load ==
-
-    virtual void load() const = 0;
 };
 
 
+// fixed pool of workers, each one own a deque of jobs, it run its newest job first
+// and steal the oldest job of others when it has nothing to do.
+// workers are started at first post, a thread not in the pool help running jobs when it wait,
+// and sleep when there is nothing to run.
+//
+//     sdl_job_group_t group;
+//     jobs.parallel_for(group, 0, count, [&](int begin, int end) { ... });
+//     jobs.post_after(group, done, [&]() { ... });
+//     jobs.wait(done);
+class sdl_job_system_t {
+public:
+    using func_t = std::function<void()>;
+    using range_func_t = std::function<void(int begin, int end)>;
 
-
-
-
-class sdl_font_t : public sdl_resource_t {
-    class info_t : public basic_info_t {
+private:
+    class job_t {
     public:
-        int ptsize = 0;
+        func_t func;
+        sdl_job_group_t* group;
+    };
 
-        info_t(const std::string& file, int ptsize) : basic_info_t(file), ptsize(ptsize) {}
-        info_t(TTF_Font* font) : basic_info_t((void*) font) {}
+    class worker_t {
+    public:
+        sdl_job_system_t* self;
+        SDL_Thread* thread = nullptr;
+        SDL_SpinLock lock = 0;
+        std::deque<job_t*> jobs;
     };
 
-public:
-    // == delete ==
+    int worker_count;
+    std::vector<std::unique_ptr<worker_t>> workers;
 
-    ~sdl_font_t() {
-        _delete((release_t) TTF_CloseFont);
-    }
+    std::atomic<int> pending{0};        // jobs in deques
+    std::atomic<int> sleeping{0};       // workers and waiters
+    std::atomic<uint32_t> next{0};      // deque to push from other threads, and to steal first
+    std::atomic<bool> started{false};
 
-    // == init ==
+    SDL_mutex* mutex = nullptr;
+    SDL_cond* cond = nullptr;
+    bool quit = false;
 
-    sdl_font_t(const std::string& file, int ptsize) : sdl_resource_t(new info_t(file, ptsize)) {}
 
-    sdl_font_t(TTF_Font* font = nullptr) : sdl_resource_t(new info_t(font)) {}
+    // worker of the calling thread, nullptr if not in any pool
+    inline static worker_t*& current() {
+        static thread_local worker_t* worker = nullptr;
+        return worker;
+    }
 
 
-    // == copy / move ==
 
-    sdl_font_t(const sdl_font_t&) noexcept = default;
+    // == worker ==
 
-    sdl_font_t& operator=(const sdl_font_t& other) noexcept {
-        _move2((release_t) TTF_CloseFont, other);
-        return *this;
-    }
+    static int worker_main(void* data) {
+        worker_t* worker = (worker_t*) data;
+        sdl_job_system_t* self = worker->self;
+        current() = worker;
 
+        while (true) {
+            job_t* job = self->pop(worker);
+            if (job) {
+                self->execute(job);
+                continue;
+            }
 
-    sdl_font_t(sdl_font_t&&) noexcept = default;
+            SDL_LockMutex(self->mutex);
+            self->sleeping++;
+            while (self->pending.load() <= 0 && self->quit == false) {
+                SDL_CondWait(self->cond, self->mutex);
+            }
+            self->sleeping--;
+            bool leave = self->quit && self->pending.load() <= 0;
+            SDL_UnlockMutex(self->mutex);
 
-    sdl_font_t& operator=(sdl_font_t&& other) noexcept {
-        _move2((release_t) TTF_CloseFont, other);
-        return *this;
+            if (leave) {
+                break;
+            }
+        }
+        return 0;
     }
-    
 
+    void push(job_t* job) {
+        start();
 
-    // == get ==
+        worker_t* worker = current();
+        if (worker == nullptr || worker->self != this) {
+            worker = workers[next.fetch_add(1, std::memory_order_relaxed) % workers.size()].get();
+        }
 
-    operator TTF_Font*() const {
-        load();
-        return (TTF_Font*) ptr->resource;
-    }
+        SDL_AtomicLock(&worker->lock);
+        worker->jobs.push_back(job);
+        SDL_AtomicUnlock(&worker->lock);
 
-    int get_size() const {
-        load();
-        return *(int*)(ptr + 1);
+        pending++;
+        if (sleeping.load() > 0) {
+            SDL_LockMutex(mutex);
+            SDL_CondSignal(cond);
+            SDL_UnlockMutex(mutex);
+        }
     }
 
-    // == load / release ==
+    // newest job of own deque, or oldest job of others
+    job_t* pop(worker_t* own) {
+        if (pending.load(std::memory_order_relaxed) <= 0 || started.load(std::memory_order_acquire) == false) {
+            return nullptr;
+        }
 
-    void load() const {
-        int* ptsize = (int*)(ptr + 1);
+        job_t* job = nullptr;
+        if (own != nullptr && own->self == this) {
+            SDL_AtomicLock(&own->lock);
+            if (own->jobs.empty() == false) {
+                job = own->jobs.back();
+                own->jobs.pop_back();
+            }
+            SDL_AtomicUnlock(&own->lock);
+        }
 
-        if (has_loaded()) {
-            if (ptsize[0] == 0) {
-                ptsize[0] = TTF_FontHeight((TTF_Font*)ptr->resource);       // some sdl2 version couldn't get font height by TTF_Font
+        size_t first = next.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < workers.size() && job == nullptr; i++) {
+            worker_t* victim = workers[(first + i) % workers.size()].get();
+            if (victim == own) {
+                continue;
             }
-            return;
+
+            SDL_AtomicLock(&victim->lock);
+            if (victim->jobs.empty() == false) {
+                job = victim->jobs.front();
+                victim->jobs.pop_front();
+            }
+            SDL_AtomicUnlock(&victim->lock);
         }
 
-        ptr->resource = TTF_OpenFont(ptr->file.c_str(), ptsize[0]);
-        if (ptr->resource == nullptr) {
-            throw sdl_exception_t("failed to open font '%s' since %s!", ptr->file.c_str(), TTF_GetError());
+        if (job) {
+            pending--;
         }
+        return job;
     }
 
-    void release() const {
-        _release((release_t) TTF_CloseFont);
+    void execute(job_t* job) {
+        job->func();
+        finish(job->group);
+        delete job;
     }
-};
 
+    void finish(sdl_job_group_t* group) {
+        if (group == nullptr) {
+            return;
+        }
 
+        std::vector<void*> continuations;
 
-enum sdl_render_text_mode_t {
-    SDLAPP_TEXT_SOLID = 3,
-    SDLAPP_TEXT_BLENDED,
-    SDLAPP_TEXT_SHADED,
-};
+        SDL_AtomicLock(&group->lock);
+        bool done = group->count.fetch_sub(1) == 1;
+        if (done) {
+            continuations.swap(group->continuations);
+        }
+        SDL_AtomicUnlock(&group->lock);
 
+        for (void* job : continuations) {
+            push((job_t*) job);
+        }
 
-class sdl_surface_t : public sdl_resource_t {
-    class info_t : public basic_info_t {
-    public:
-        sdl_font_t font;
-        SDL_Color fg;
-        SDL_Color bg;
-        uint32_t warp_length;
+        // wake waiters of the group, which may be destroyed now
+        if (done && sleeping.load() > 0) {
+            SDL_LockMutex(mutex);
+            SDL_CondBroadcast(cond);
+            SDL_UnlockMutex(mutex);
+        }
+    }
+
+    job_t* create(sdl_job_group_t* group, func_t&& func) {
+        if (group) {
+            SDL_AtomicLock(&group->lock);
+            group->count.fetch_add(1, std::memory_order_relaxed);
+            SDL_AtomicUnlock(&group->lock);
+        }
+        return new job_t{std::move(func), group};
+    }
+
+    // any thread may post first, so workers are created under the mutex
+    void start() {
+        if (started.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        SDL_LockMutex(mutex);
+        if (started.load(std::memory_order_relaxed) == false) {
+            for (int i = 0; i < worker_count; i++) {
+                workers.emplace_back(new worker_t);
+                workers.back()->self = this;
+            }
+            for (auto& worker : workers) {
+                worker->thread = SDL_CreateThread(worker_main, "sdl_job_system_t", worker.get());
+                if (worker->thread == nullptr) {
+                    SDL_UnlockMutex(mutex);
+                    throw sdl_exception_t("failed to create thread since %s", SDL_GetError());
+                }
+            }
+            started.store(true, std::memory_order_release);
+        }
+        SDL_UnlockMutex(mutex);
+    }
 
-        info_t(const sdl_font_t& font, const std::string& text, sdl_render_text_mode_t mode, SDL_Color fg, SDL_Color bg, uint32_t warp_length
-        )
-        : basic_info_t(text, mode), font(font), fg(fg), bg(bg), warp_length(warp_length) {}
-    };
 
 public:
     // == delete ==
 
-    ~sdl_surface_t() {
-        _delete((release_t) SDL_FreeSurface);
+    ~sdl_job_system_t() {
+        stop();
+
+        SDL_DestroyCond(cond);
+        SDL_DestroyMutex(mutex);
     }
 
 
     // == init ==
 
-    sdl_surface_t(const std::string& file) : sdl_resource_t(new basic_info_t(file)) {}
-    sdl_surface_t(SDL_Surface* surface = nullptr) : sdl_resource_t(new basic_info_t(surface)) {}
+    // worker_count 0 means number of cpu cores - 1, the waiting thread is the last one
+    sdl_job_system_t(int worker_count = 0) : worker_count(worker_count) {
+        if (this->worker_count <= 0) {
+            this->worker_count = SDL_max(SDL_GetCPUCount() - 1, 1);
+        }
 
-    sdl_surface_t(
-                const sdl_font_t& font, const std::string& text, sdl_render_text_mode_t mode = SDLAPP_TEXT_SOLID,
-                SDL_Color fg = SDLAPP_COLOR_WHITE, SDL_Color bg = SDLAPP_COLOR_BLACK,
-                uint32_t warp_length = 0
-    ):
-    sdl_resource_t(new info_t(font, text, mode, fg, bg, warp_length)) {}
+        mutex = SDL_CreateMutex();
+        cond = SDL_CreateCond();
+        if (mutex == nullptr || cond == nullptr) {
+            throw sdl_exception_t("failed to create job system since %s", SDL_GetError());
+        }
+    }
 
+    sdl_job_system_t(const sdl_job_system_t&) = delete;
+    sdl_job_system_t& operator=(const sdl_job_system_t&) = delete;
 
-    // == copy / move ==
 
-    sdl_surface_t(const sdl_surface_t& other) noexcept = default;
+    // == post ==
 
-    sdl_surface_t& operator=(const sdl_surface_t& other) noexcept {
-        _move2((release_t) SDL_DestroyTexture, other);
-        return *this;
+    void post(func_t func) {
+        push(create(nullptr, std::move(func)));
     }
-    
-
-    sdl_surface_t(sdl_surface_t&& other) noexcept = default;
 
-    sdl_surface_t& operator=(sdl_surface_t&& other) noexcept {
-        _move2((release_t) SDL_DestroyTexture, other);
-        return *this;
+    void post(sdl_job_group_t& group, func_t func) {
+        push(create(&group, std::move(func)));
     }
-    
 
+    // run func after all jobs of after finished, it is counted in group
+    void post_after(sdl_job_group_t& after, sdl_job_group_t& group, func_t func) {
+        job_t* job = create(&group, std::move(func));
 
-    // == get ==
+        SDL_AtomicLock(&after.lock);
+        bool done = after.count.load(std::memory_order_acquire) == 0;
+        if (done == false) {
+            after.continuations.push_back(job);
+        }
+        SDL_AtomicUnlock(&after.lock);
 
-    operator SDL_Surface*() const {
-        load();
-        return (SDL_Surface*) ptr->resource;
+        if (done) {
+            push(job);
+        }
     }
 
-    int get_width() const {
-        load();
-        return ((SDL_Surface*) ptr->resource)->w;
-    }
+    // split [begin, end) into ranges of grain, grain 0 means 4 ranges per worker
+    void parallel_for(sdl_job_group_t& group, int begin, int end, range_func_t func, int grain = 0) {
+        if (grain <= 0) {
+            grain = SDL_max((end - begin) / (worker_count * 4), 1);
+        }
 
-    int get_height() const {
-        load();
-        return ((SDL_Surface*) ptr->resource)->h;
+        auto shared = std::make_shared<range_func_t>(std::move(func));
+        for (int i = begin; i < end; i += grain) {
+            int last = SDL_min(i + grain, end);
+            post(group, [shared, i, last]() {
+                (*shared)(i, last);
+            });
+        }
     }
 
+    // blocking version, return when all ranges are done
+    void parallel_for(int begin, int end, range_func_t func, int grain = 0) {
+        sdl_job_group_t group;
+        parallel_for(group, begin, end, std::move(func), grain);
+        wait(group);
+    }
 
-    // == load / release ==
 
-    void load() const {
-        if (has_loaded()) {
-            return;
-        }
+    // == wait ==
 
-        if (ptr->load_method == 0) {
-            ptr->resource = IMG_Load(ptr->file.c_str());
+    // run jobs until the group is done, it can be called in on_update() or inside a job.
+    // the group can be destroyed after this returned.
+    void wait(sdl_job_group_t& group) {
+        while (group.count.load() != 0) {
+            job_t* job = pop(current());
+            if (job) {
+                execute(job);
+                continue;
+            }
 
-            if (ptr->resource == nullptr) {
-                throw sdl_exception_t("failed to load texture '%s', maybe the file not exist!", ptr->file.c_str());
+            // sleep until a job posted or the group done, finish() check sleeping after the count drop
+            SDL_LockMutex(mutex);
+            sleeping++;
+            while (pending.load() <= 0 && group.count.load() != 0) {
+                SDL_CondWait(cond, mutex);
             }
+            sleeping--;
+            SDL_UnlockMutex(mutex);
+        }
+
+        // the last job may still hold the lock after count become 0
+        SDL_AtomicLock(&group.lock);
+        SDL_AtomicUnlock(&group.lock);
+    }
 
+    // finish all posted jobs then join workers, next post start them again
+    void stop() {
+        if (started.load(std::memory_order_acquire) == false) {
             return;
         }
 
-        info_t* info = (info_t*) ptr;
-
-        switch (info->load_method) {
-            case SDLAPP_TEXT_SOLID:
-                info->resource = TTF_RenderUTF8_Solid_Wrapped(info->font, info->file.c_str(), info->fg, info->warp_length);
-                break;
-            case SDLAPP_TEXT_BLENDED:
-                info->resource = TTF_RenderUTF8_Blended_Wrapped(info->font, info->file.c_str(), info->fg, info->warp_length);
-                break;
-            case SDLAPP_TEXT_SHADED:
-                info->resource = TTF_RenderUTF8_Shaded_Wrapped(info->font, info->file.c_str(), info->fg, info->bg, info->warp_length);
-                break;
+        SDL_LockMutex(mutex);
+        quit = true;
+        SDL_CondBroadcast(cond);
+        SDL_UnlockMutex(mutex);
 
-            default:
-                throw sdl_exception_t("invalid text render mode %d!", info->load_method);
-        }
-        if (info->resource == nullptr) {
-            throw sdl_exception_t("failed to render text '%s'!", info->file.c_str());
+        for (auto& worker : workers) {
+            SDL_WaitThread(worker->thread, nullptr);
         }
+
+        SDL_LockMutex(mutex);
+        workers.clear();
+        quit = false;
+        started.store(false, std::memory_order_release);
+        SDL_UnlockMutex(mutex);
     }
 
-    void release() const {
-        _release((release_t) SDL_FreeSurface);
+
+    // == get ==
+
+    inline int get_worker_count() const {
+        return worker_count;
     }
-};
 
+    // index of the calling worker in this pool, -1 if not a worker
+    int get_worker_index() const {
+        for (size_t i = 0; i < workers.size(); i++) {
+            if (workers[i].get() == current()) {
+                return (int) i;
+            }
+        }
+        return -1;
+    }
+};
 
 
 
 
-class sdl_texture_t : public sdl_resource_t {
-    class texture_info_t : public basic_info_t {
-    public:
-        sdl_window_t* owner;
-        int width = 0;
-        int height = 0;
 
-        texture_info_t(void* texture, int load_method, sdl_window_t* owner, int width, int height
-        ):
-        basic_info_t(texture, load_method), owner(owner), width(width), height(height) {}
+// == task queue ==
 
+// lock-free queue of closures, any thread can push, only one thread can pop.
+// a push is an exchange on head, then a link from the previous node.
+class sdl_task_queue_t {
+public:
+    using func_t = std::function<void()>;
 
-        texture_info_t(const std::string& file, int load_method, sdl_window_t* owner
-        ):
-        basic_info_t(file, load_method), owner(owner) {}
+private:
+    class node_t {
+    public:
+        std::atomic<node_t*> next{nullptr};
+        func_t func;
     };
 
+    std::atomic<node_t*> head;      // last pushed
+    node_t* tail;                   // next to pop, owned by consumer
+    node_t stub;
 
-    class surface_info_t : public texture_info_t {
+    void push(node_t* node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        node_t* prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+public:
+    // == delete ==
+
+    ~sdl_task_queue_t() {
+        func_t func;
+        while (pop(func)) {}
+    }
+
+
+    // == init ==
+
+    sdl_task_queue_t() : head(&stub), tail(&stub) {}
+
+    sdl_task_queue_t(const sdl_task_queue_t&) = delete;
+    sdl_task_queue_t& operator=(const sdl_task_queue_t&) = delete;
+
+
+    // == push / pop ==
+
+    void push(func_t func) {
+        node_t* node = new node_t;
+        node->func = std::move(func);
+        push(node);
+    }
+
+    // false if empty, or the newest push is not linked yet
+    bool pop(func_t& func) {
+        node_t* node = tail;
+        node_t* next = node->next.load(std::memory_order_acquire);
+
+        if (node == &stub) {
+            if (next == nullptr) {
+                return false;
+            }
+            tail = node = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (next == nullptr) {
+            if (node != head.load(std::memory_order_acquire)) {
+                return false;
+            }
+            push(&stub);        // keep one node in queue, so the last one can be taken
+            next = node->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                return false;
+            }
+        }
+
+        tail = next;
+        func = std::move(node->func);
+        delete node;
+        return true;
+    }
+
+    // may be wrong while others pushing
+    bool empty() const {
+        return tail->next.load(std::memory_order_acquire) == nullptr && tail == head.load(std::memory_order_acquire);
+    }
+};
+
+
+
+
+
+// == subsystems ==
+
+// brings up sdl subsystems, ttf, image and mixer, and times each one.
+// a deferred one is brought up the first time it is needed: ttf by the first font, image by the first image,
+// mixer and audio by the first music or chunk, video by init_window(),
+// and other sdl subsystems, such as joystick and gamecontroller, after the first frame presented.
+// audio is only opened on the thread which added the mixer, sdl_loader_t open it before posting music and chunks,
+// so loads on other threads before that fail.
+class sdl_subsystems_t {
+public:
+    class timing_t {
+    public:
+        const char* name;
+        double ms;
+    };
+
+private:
+    enum state_t {
+        STATE_NONE,
+        STATE_DEFERRED,
+        STATE_READY,
+    };
+
+    std::atomic<int> ttf{STATE_NONE};
+    std::atomic<int> image{STATE_NONE};
+    std::atomic<int> mixer{STATE_NONE};
+    std::atomic<uint32_t> deferred_sdl{0};
+    SDL_mutex* mutex;                       // held by every init, they may be slow
+
+    SDL_threadID mixer_thread = 0;
+
+    int image_flags = 0;
+    int mixer_flags = 0;
+    int audio_frequency = 0;
+    uint16_t audio_format = 0;
+    int audio_channels = 0;
+    int audio_chunk_size = 0;
+
+    std::vector<timing_t> timings;
+
+
+    // called with the mutex locked
+    template <typename func_t>
+    bool timed(const char* name, const func_t& func) {
+        uint64_t begin = SDL_GetPerformanceCounter();
+        bool ok = func();
+        timings.push_back({name, (SDL_GetPerformanceCounter() - begin) * 1000.0 / SDL_GetPerformanceFrequency()});
+        return ok;
+    }
+
+    bool init_ttf() {
+        bool ok = timed("ttf", []() {
+            return TTF_Init() == 0;
+        });
+        ttf = ok ? STATE_READY : STATE_NONE;
+        return ok;
+    }
+
+    bool init_image() {
+        int flags = image_flags;
+        timed("image", [flags]() {
+            IMG_Init(flags);
+            return true;
+        });
+        image = STATE_READY;
+        return true;
+    }
+
+    bool init_mixer() {
+        bool ok = init_sdl(SDL_INIT_AUDIO, false);
+
+        int flags = mixer_flags;
+        ok = ok && timed("mixer", [flags]() {
+            Mix_Init(flags);
+            return true;
+        });
+        ok = ok && timed("audio_open", [this]() {
+            return Mix_OpenAudio(audio_frequency, audio_format, audio_channels, audio_chunk_size) == 0;
+        });
+
+        mixer = ok ? STATE_READY : STATE_NONE;
+        return ok;
+    }
+
+    // init a deferred one once, from any thread
+    void require(std::atomic<int>& state, bool (sdl_subsystems_t::*init)(), const char* name) {
+        if (state.load(std::memory_order_acquire) != STATE_DEFERRED) {
+            return;
+        }
+
+        SDL_LockMutex(mutex);
+        if (state.load(std::memory_order_relaxed) == STATE_DEFERRED) {
+            if ((this->*init)() == false) {
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "failed to init %s since %s", name, SDL_GetError());
+            }
+        }
+        SDL_UnlockMutex(mutex);
+    }
+
+    // called with the mutex locked
+    bool init_sdl(uint32_t flags, bool throw_error) {
+        static const std::pair<uint32_t, const char*> subsystems[] = {
+            {SDL_INIT_TIMER, "sdl_timer"}, {SDL_INIT_EVENTS, "sdl_events"}, {SDL_INIT_VIDEO, "sdl_video"},
+            {SDL_INIT_AUDIO, "sdl_audio"}, {SDL_INIT_JOYSTICK, "sdl_joystick"}, {SDL_INIT_HAPTIC, "sdl_haptic"},
+            {SDL_INIT_GAMECONTROLLER, "sdl_gamecontroller"}, {SDL_INIT_SENSOR, "sdl_sensor"},
+        };
+
+        for (auto& subsystem : subsystems) {
+            if ((flags & subsystem.first) == 0 || SDL_WasInit(subsystem.first)) {
+                continue;
+            }
+
+            uint32_t flag = subsystem.first;
+            bool ok = timed(subsystem.second, [flag]() {
+                return SDL_InitSubSystem(flag) == 0;
+            });
+            if (ok == false) {
+                if (throw_error) {
+                    SDL_UnlockMutex(mutex);
+                    throw sdl_exception_t("failed to init %s since %s!", subsystem.second, SDL_GetError());
+                }
+                return false;
+            }
+        }
+        return true;
+    }
+
+
+public:
+    // == delete ==
+
+    ~sdl_subsystems_t() {
+        SDL_DestroyMutex(mutex);
+    }
+
+
+    // == init ==
+
+    sdl_subsystems_t() {
+        mutex = SDL_CreateMutex();
+        if (mutex == nullptr) {
+            throw sdl_exception_t("failed to create subsystems since %s", SDL_GetError());
+        }
+    }
+
+    sdl_subsystems_t(const sdl_subsystems_t&) = delete;
+    sdl_subsystems_t& operator=(const sdl_subsystems_t&) = delete;
+
+    // init each subsystem of flags not inited yet, throw or return false if failed
+    bool require_sdl(uint32_t flags, bool throw_error = true) {
+        SDL_LockMutex(mutex);
+        bool ok = init_sdl(flags, throw_error);
+        SDL_UnlockMutex(mutex);
+        return ok;
+    }
+
+    // flags brought up by require_deferred_sdl(), after the first frame
+    void add_deferred_sdl(uint32_t flags) {
+        deferred_sdl |= flags;
+    }
+
+    void add_ttf(bool deferred) {
+        SDL_LockMutex(mutex);
+        if (ttf == STATE_NONE) {
+            if (deferred) {
+                ttf = STATE_DEFERRED;
+            }
+            else if (init_ttf() == false) {
+                SDL_UnlockMutex(mutex);
+                throw sdl_exception_t("failed to init ttf");
+            }
+        }
+        SDL_UnlockMutex(mutex);
+    }
+
+    void add_image(int flags, bool deferred) {
+        SDL_LockMutex(mutex);
+        if (image == STATE_NONE) {
+            image_flags = flags;
+            if (deferred) {
+                image = STATE_DEFERRED;
+            }
+            else {
+                init_image();
+            }
+        }
+        SDL_UnlockMutex(mutex);
+    }
+
+    void add_mixer(int flags, int frequency, uint16_t format, int channels, int chunk_size, bool deferred) {
+        SDL_LockMutex(mutex);
+        if (mixer == STATE_NONE) {
+            mixer_flags = flags;
+            audio_frequency = frequency;
+            audio_format = format;
+            audio_channels = channels;
+            audio_chunk_size = chunk_size;
+            mixer_thread = SDL_ThreadID();
+
+            if (deferred) {
+                mixer = STATE_DEFERRED;
+            }
+            else if (init_mixer() == false) {
+                SDL_UnlockMutex(mutex);
+                throw sdl_exception_t("failed to open audio");
+            }
+        }
+        SDL_UnlockMutex(mutex);
+    }
+
+
+    // == require ==
+
+    inline void require_ttf() {
+        require(ttf, &sdl_subsystems_t::init_ttf, "ttf");
+    }
+
+    inline void require_image() {
+        require(image, &sdl_subsystems_t::init_image, "image");
+    }
+
+    // only on the thread which added the mixer, some audio backends must be opened there
+    inline void require_mixer() {
+        if (mixer.load(std::memory_order_acquire) == STATE_DEFERRED && SDL_ThreadID() != mixer_thread) {
+            return;
+        }
+        require(mixer, &sdl_subsystems_t::init_mixer, "mixer");
+    }
+
+    // deferred sdl subsystems, the window call it after every frame
+    inline void require_deferred_sdl() {
+        uint32_t flags = deferred_sdl.exchange(0);
+        if (flags != 0) {
+            require_sdl(flags, false);
+        }
+    }
+
+
+    // == quit ==
+
+    void quit() {
+        SDL_LockMutex(mutex);
+        if (mixer == STATE_READY) {
+            Mix_CloseAudio();
+        }
+        Mix_Quit();
+        IMG_Quit();
+        TTF_Quit();
+        SDL_Quit();
+
+        ttf = STATE_NONE;
+        image = STATE_NONE;
+        mixer = STATE_NONE;
+        deferred_sdl = 0;
+        SDL_UnlockMutex(mutex);
+    }
+
+
+    // == get ==
+
+    // time of each init in order, such as "sdl_video", "ttf" or "audio_open"
+    std::vector<timing_t> get_timings() const {
+        SDL_LockMutex(mutex);
+        std::vector<timing_t> result = timings;
+        SDL_UnlockMutex(mutex);
+        return result;
+    }
+
+    int get_audio_chunk_size() const {
+        return audio_chunk_size;
+    }
+
+    double get_total_ms() const {
+        double total = 0.0;
+        for (const timing_t& timing : get_timings()) {
+            total += timing.ms;
+        }
+        return total;
+    }
+
+    void log_timings() const {
+        std::vector<timing_t> result = get_timings();
+        double total = 0.0;
+        for (const timing_t& timing : result) {
+            SDL_Log("init %-20s %8.3f ms", timing.name, timing.ms);
+            total += timing.ms;
+        }
+        SDL_Log("init %-20s %8.3f ms", "total", total);
+    }
+};
+
+
+inline sdl_subsystems_t& sdl_subsystems() {
+    static sdl_subsystems_t subsystems;
+    return subsystems;
+}
+
+
+
+
+
+// == service ==
+
+// a service attached to a window, it get callback from sdl_window_t::run
+// on_frame() is called on render thread before every on_render()
+// on_stop() is called when loop exit, before stopping jobs and waiting threads
+class sdl_service_t {
+public:
+    virtual ~sdl_service_t() {}
+
+    virtual void on_frame(sdl_tick_t tick) {}
+    virtual void on_stop() {}
+};
+
+
+
+// == sdl_window_t ==
+
+
+class sdl_window_t : public sdl_basic_t {
+    friend class sdl_texture_t;
+    friend class sdl_font_t;
+    friend class sdl_loader_t;
+    friend class sdl_atlas_t;
+    friend class sdl_entity_manager_t;
+    friend class sdl_resource_cache_t;
+    friend class sdl_text_pipeline_t;
+    friend class sdl_layer_t;
+    friend class sdl_voice_manager_t;
+
+
+protected:
+    // == running variables ==
+
+    bool running = true;
+    SDL_Window* window = nullptr;
+    SDL_Renderer* renderer = nullptr;
+
+    int window_width = 0;
+    int window_height = 0;
+
+
+    SDL_Event event;
+    std::vector<SDL_Event> events;      // batch of on_events()
+    bool event_coalesce = true;
+
+    static constexpr uint32_t NEVER = (uint32_t) -1;      // next time of what is disabled or idle
+
+    uint32_t update_delay = 50;
+    uint32_t next_update_time = 0;
+
+    uint32_t render_delay = 15;
+    uint32_t next_render_time = 0;
+    bool render_lazy_draw = false;
+
+    bool render_partial = false;        // only redraw dirty rects into back_buffer
+    bool dirty_full = true;
+    std::vector<SDL_Rect> dirty_rects;
+    SDL_Rect redraw_rect = {0, 0, 0, 0};        // the region drawing by on_render()
+    SDL_Texture* back_buffer = nullptr;
+    uint32_t render_reset_count = 0;    // contents of target textures are lost when it changed
+
+    bool pacing = false;                // render at display refresh rate, idle when nothing changed
+    int pacing_idle_frames = 60;        // unchanged frames before idle
+    uint32_t pacing_idle_delay = 0;     // milliseconds between frames when idle, 0 means only on events
+    double pacing_interval = 0.0;       // milliseconds of a display refresh
+    double pacing_next = 0.0;
+    bool pacing_idle = false;
+    bool frame_changed = true;
+    int unchanged_frames = 0;
+
+    double frame_cost = 0.0;            // milliseconds before present, moving average
+    double frame_rate = 0.0;            // frames in last second
+    double idle_ratio = 0.0;            // part of last second waiting for events
+    uint64_t stats_begin = 0;
+    uint64_t stats_wait = 0;
+    int stats_frames = 0;
+
+    double fixed_step = 0.0;            // seconds, on_update() run at fixed step if > 0
+    int fixed_max_steps = 5;            // max on_update() in a frame when catching up
+    double render_interval = 0.0;       // seconds, override render_delay in fixed update mode
+    uint64_t update_count = 0;
+    float render_alpha = 1.0f;
+
+    std::vector<SDL_Thread*> threads;      // long running threads, use jobs for short tasks
+    sdl_job_system_t jobs;
+
+    std::vector<sdl_service_t*> services;
+
+    SDL_Texture* placeholder_texture = nullptr;     // returned by texture still loading in background
+
+    SDL_threadID render_thread = 0;
+    sdl_task_queue_t tasks;             // posted by any thread, run on render thread
+    double task_budget = 2.0;           // milliseconds of tasks in a frame, 0 means no limit
+    std::atomic<bool> wake_pending{false};
+
+
+
+
+    virtual void on_setup() {
+        init_info_t info;
+        init_sdl(info);
+        init_window(info);
+    }
+
+    virtual void on_event(SDL_Event& e) {
+        switch (e.type) {
+            case SDL_QUIT:
+                post_stop();
+                return;
+            case SDL_WINDOWEVENT:
+                switch (e.window.event) {
+                    case SDL_WINDOWEVENT_SIZE_CHANGED:
+                        window_width = e.window.data1;
+                        window_height = e.window.data2;
+                        post_redraw();
+                        return;
+                    case SDL_WINDOWEVENT_DISPLAY_CHANGED:
+                        if (pacing) {
+                            update_refresh_rate();
+                        }
+                        post_redraw();
+                        return;
+                }
+            case SDL_MOUSEWHEEL:
+            case SDL_KEYDOWN:
+            case SDL_KEYUP:
+            case SDL_MOUSEBUTTONDOWN:
+            case SDL_MOUSEBUTTONUP:
+            case SDL_MOUSEMOTION:
+                if (render_partial) {
+                    post_frame();       // app mark what changed by post_redraw(rect)
+                    return;
+                }
+                post_redraw();
+                return;
+            case SDL_RENDER_TARGETS_RESET:
+            case SDL_RENDER_DEVICE_RESET:
+                render_reset_count++;
+                post_redraw();
+                return;
+        }
+    }
+
+    // all events taken from the queue at once, consecutive motion / wheel / resize events are merged.
+    // override this to handle them together, default one call on_event() for each.
+    virtual void on_events(std::vector<SDL_Event>& events) {
+        for (SDL_Event& e : events) {
+            SDLAPP_PROFILE_ZONE("event");
+            on_event(e);
+        }
+    }
+
+    virtual void on_update(sdl_tick_t tick) {
+        
+    }
+
+    // to interpolate between fixed updates, see get_render_alpha()
+    virtual void on_render(sdl_tick_t tick) {
+        
+    }
+
+
+
+
+
+    // == init ==
+
+    class init_info_t {
+    public:
+        uint32_t sdl_flags = SDL_INIT_EVERYTHING;
+        SDL_LogPriority log_priority = SDL_LOG_PRIORITY_INFO;
+
+        // only timer and events of sdl_flags are inited at once, others when first needed or after the first frame.
+        // see sdl_subsystems_t.
+        bool lazy_init = false;
+
+        bool ttf_flags = true;
+
+        int image_flags = 0x3f;
+        int mixer_flags = 0xff;
+
+        int      audio_frequency = MIX_DEFAULT_FREQUENCY;
+        uint16_t audio_format = MIX_DEFAULT_FORMAT;
+        int      audio_channels = MIX_DEFAULT_CHANNELS;
+        int      audio_chunk_size = 1024;
+
+
+
+        const char*     wnd_title = "basic window";
+        SDL_Point       wnd_position = {SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED};
+        SDL_Point       wnd_size = {SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED};
+        SDL_WindowFlags wnd_flags = SDL_WINDOW_RESIZABLE;
+        const char*     wnd_icon = nullptr;
+
+        int rnd_index = -1;
+        int rnd_flags = SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC;
+    };
+
+    // sdl_subsystems().log_timings() show how long each one took
+    void init_sdl(init_info_t& info) {
+        sdl_subsystems_t& subsystems = sdl_subsystems();
+
+        subsystems.require_sdl(info.lazy_init ? info.sdl_flags & (SDL_INIT_TIMER | SDL_INIT_EVENTS) : info.sdl_flags);
+        if (info.lazy_init) {
+            // video by init_window() and audio by the mixer, the rest after the first frame
+            const uint32_t by_need = SDL_INIT_TIMER | SDL_INIT_EVENTS | SDL_INIT_VIDEO | SDL_INIT_AUDIO;
+            subsystems.add_deferred_sdl(info.sdl_flags & ~by_need);
+        }
+
+        if (info.log_priority) {
+            SDL_LogSetAllPriority(info.log_priority);
+        }
+        if (info.ttf_flags) {
+            subsystems.add_ttf(info.lazy_init);
+        }
+        if (info.image_flags) {
+            subsystems.add_image(info.image_flags, info.lazy_init);
+        }
+        if (info.mixer_flags) {
+            subsystems.add_mixer(info.mixer_flags,
+                        info.audio_frequency, info.audio_format, info.audio_channels, info.audio_chunk_size,
+                        info.lazy_init
+            );
+        }
+    }
+
+
+    void init_window(init_info_t& info) {
+        if (window) {
+            return;
+        }
+
+        sdl_subsystems().require_sdl(SDL_INIT_VIDEO);
+
+        window = SDL_CreateWindow(info.wnd_title,
+            info.wnd_position.x, info.wnd_position.y,
+            info.wnd_size.x, info.wnd_size.y,
+            info.wnd_flags
+        );
+        if (window == nullptr) {
+            throw sdl_exception_t("failed to create window since %s!", SDL_GetError());
+        }
+
+        SDL_GetWindowSize(window, &window_width, &window_height);
+        redraw_rect = {0, 0, window_width, window_height};
+        
+        if (info.wnd_icon) {
+            sdl_subsystems().require_image();
+            SDL_Surface* surface = IMG_Load(info.wnd_icon);
+
+            if (surface == nullptr) {
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "failed to set window icon, %s", IMG_GetError());
+            }
+            else {
+                SDL_SetWindowIcon(window, surface);
+                SDL_FreeSurface(surface);
+            }
+        }
+
+        if (info.rnd_flags) {
+            render_thread = SDL_ThreadID();
+            renderer = SDL_CreateRenderer(window, info.rnd_index, info.rnd_flags);
+
+            if (renderer == nullptr) {
+                throw sdl_exception_t("failed to create renderer since %s!", SDL_GetError());
+            }
+        }
+    }
+
+
+
+
+    // == post ==
+
+    inline void post_redraw() {
+        dirty_full = true;
+        post_frame();
+    }
+
+    // only rect need redraw, in partial redraw mode
+    inline void post_redraw(const SDL_Rect& rect) {
+        if (rect.w > 0 && rect.h > 0) {
+            dirty_rects.push_back(rect);
+        }
+        post_frame();
+    }
+
+    // run a frame in lazy draw mode without marking anything dirty,
+    // in partial redraw mode it only present the back buffer again.
+    inline void post_frame() {
+        frame_changed = true;
+        if (render_lazy_draw == true) {
+            next_render_time = 1;
+        }
+        else if (pacing_idle) {
+            wake_pacing();
+        }
+    }
+
+    inline void post_stop() {
+        running = false;
+    }
+
+    // run func on render thread at next frame, can be called from any thread.
+    // the ones left when loop exit run at the end of run(), after jobs and threads stopped.
+    void post_task(sdl_task_queue_t::func_t func) {
+        tasks.push(std::move(func));
+        post_wake();
+    }
+
+    // run func(data) on render thread at next frame, can be called from any thread.
+    void post_release(void (*func)(void*), void* data) {
+        post_task([func, data]() {
+            func(data);
+        });
+    }
+
+    // wake up the loop from any thread, then it redraw in lazy draw mode.
+    // only one wake event is in the queue at a time.
+    inline void post_wake() {
+        if (wake_pending.exchange(true, std::memory_order_acq_rel) == true) {
+            return;
+        }
+
+        SDL_Event e;
+        SDL_zero(e);
+        e.type = get_wake_event();
+        if (SDL_PushEvent(&e) != 1) {
+            wake_pending.store(false, std::memory_order_release);
+        }
+    }
+
+
+
+    // == create ==
+
+    // a dedicated thread joined when run() exit, such as a worker blocking on its own queue
+    SDL_Thread* create_thread(const char* name, SDL_ThreadFunction func, void* data) {
+        SDL_Thread* thread = SDL_CreateThread(func, name, data);
+        if (thread == nullptr) {
+            throw sdl_exception_t("failed to create thread since %s", SDL_GetError());
+        }
+
+        threads.push_back(thread);
+        return thread;
+    }
+
+
+    // == service ==
+
+    void attach_service(sdl_service_t* service) {
+        services.push_back(service);
+    }
+
+    void detach_service(sdl_service_t* service) {
+        for (size_t i = 0; i < services.size(); i++) {
+            if (services[i] == service) {
+                services.erase(services.begin() + i);
+                return;
+            }
+        }
+    }
+
+
+    // == get ==
+
+    // frames per second in last second
+    inline double get_frame_rate() const {
+        return frame_rate;
+    }
+
+    // 0 ~ 1, part of last second spent waiting for events
+    inline double get_idle_ratio() const {
+        return idle_ratio;
+    }
+
+    // milliseconds of a frame from on_frame() of services to present, present excluded, moving average
+    inline double get_frame_cost() const {
+        return frame_cost;
+    }
+
+    inline bool is_pacing_idle() const {
+        return pacing_idle;
+    }
+
+    // the region drawing by on_render(), the whole window if not in partial redraw mode
+    inline const SDL_Rect& get_redraw_rect() const {
+        return redraw_rect;
+    }
+
+    // the thread created renderer, or any thread before that
+    inline bool in_render_thread() const {
+        return render_thread == 0 || render_thread == SDL_ThreadID();
+    }
+
+    inline static uint32_t get_wake_event() {
+        static uint32_t type = SDL_RegisterEvents(1);
+        return type;
+    }
+
+
+    // == set ==
+
+    inline void set_update_delay(uint32_t delay) {
+        update_delay = delay;
+    }
+
+    inline void set_render_delay(uint32_t delay) {
+        render_delay = delay;
+    }
+
+    // milliseconds of posted tasks run in a frame, the rest wait next frame. 0 means no limit.
+    inline void set_task_budget(double budget) {
+        task_budget = budget;
+    }
+
+
+
+    inline void disable_update() {
+        update_delay = NEVER;
+        next_update_time = NEVER;
+    }
+
+    inline void enable_lazy_draw() {
+        render_lazy_draw = true;
+    }
+
+    // lazy draw which keep the frame in a back buffer and only redraw dirty rects of post_redraw(rect).
+    // on_render() is called once for each merged rect with the clip rect set, see get_redraw_rect().
+    inline void enable_partial_redraw() {
+        render_lazy_draw = true;
+        render_partial = true;
+        post_redraw();
+    }
+
+    // dispatch every motion / wheel / resize event, such as for drawing by mouse
+    inline void disable_event_coalesce() {
+        event_coalesce = false;
+    }
+
+
+
+    // render at the refresh rate of display instead of render_delay, at a divisor of it if frames cost more.
+    // after idle_frames frames without post_redraw() or input, it render every idle_delay ms,
+    // or only on events if idle_delay is 0, and return to full rate on next change.
+    // animations must call post_redraw() to keep it running, as in lazy draw mode.
+    inline void enable_adaptive_pacing(int idle_frames = 60, uint32_t idle_delay = 0) {
+        pacing = true;
+        pacing_idle_frames = idle_frames;
+        pacing_idle_delay = idle_delay;
+        pacing_interval = 0.0;
+    }
+
+    inline void disable_adaptive_pacing() {
+        pacing = false;
+        pacing_idle = false;
+    }
+
+
+
+    // run on_update() at exactly rate per second by SDL_GetPerformanceCounter(),
+    // tick of on_update() become the simulated time, max_steps limit updates to catch up in a frame.
+    inline void enable_fixed_update(double rate, int max_steps = 5) {
+        fixed_step = 1.0 / rate;
+        fixed_max_steps = max_steps;
+    }
+
+    inline void disable_fixed_update() {
+        fixed_step = 0.0;
+    }
+
+    // frame rate for fixed update mode, such as 60.0 or 143.856
+    inline void set_render_rate(double rate) {
+        render_interval = 1.0 / rate;
+    }
+
+
+
+    // == get ==
+
+    // seconds between on_update() in fixed update mode
+    inline double get_update_step() const {
+        return fixed_step;
+    }
+
+    inline uint64_t get_update_count() const {
+        return update_count;
+    }
+
+    // in on_render(), how far between the last and next fixed update, 1 if not in fixed update mode
+    inline float get_render_alpha() const {
+        return render_alpha;
+    }
+
+
+
+    // == loop ==
+
+    // merge an event into the previous one if they are the same kind from the same source
+    static bool merge_event(SDL_Event& prev, const SDL_Event& e) {
+        if (prev.type != e.type) {
+            return false;
+        }
+
+        switch (e.type) {
+            case SDL_MOUSEMOTION:
+                if (prev.motion.windowID != e.motion.windowID || prev.motion.which != e.motion.which
+                            || prev.motion.state != e.motion.state) {
+                    return false;
+                }
+                prev.motion.xrel += e.motion.xrel;
+                prev.motion.yrel += e.motion.yrel;
+                prev.motion.x = e.motion.x;
+                prev.motion.y = e.motion.y;
+                prev.motion.timestamp = e.motion.timestamp;
+                return true;
+
+            case SDL_MOUSEWHEEL:
+                if (prev.wheel.windowID != e.wheel.windowID || prev.wheel.which != e.wheel.which
+                            || prev.wheel.direction != e.wheel.direction) {
+                    return false;
+                }
+                prev.wheel.x += e.wheel.x;
+                prev.wheel.y += e.wheel.y;
+                prev.wheel.preciseX += e.wheel.preciseX;
+                prev.wheel.preciseY += e.wheel.preciseY;
+#if SDL_VERSION_ATLEAST(2, 26, 0)
+                prev.wheel.mouseX = e.wheel.mouseX;     // since sdl 2.26, the rest since 2.0.18
+                prev.wheel.mouseY = e.wheel.mouseY;
+#endif
+                prev.wheel.timestamp = e.wheel.timestamp;
+                return true;
+
+            case SDL_WINDOWEVENT:
+                if (prev.window.windowID != e.window.windowID || prev.window.event != e.window.event) {
+                    return false;
+                }
+                switch (e.window.event) {
+                    case SDL_WINDOWEVENT_MOVED:
+                    case SDL_WINDOWEVENT_RESIZED:
+                    case SDL_WINDOWEVENT_SIZE_CHANGED:
+                        prev = e;       // only the last size matters
+                        return true;
+                }
+                return false;
+        }
+        return false;
+    }
+
+    // take all queued events after the first one, drop wake events and merge the rest
+    void collect_events() {
+        static const int CHUNK = 128;
+        static const size_t MAX_EVENTS = 4096;     // leave the rest to next batch if events keep coming
+
+        events.clear();
+        events.push_back(event);
+
+        while (events.size() < MAX_EVENTS) {
+            size_t size = events.size();
+            events.resize(size + CHUNK);
+
+            int count = SDL_PeepEvents(&events[size], CHUNK, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+            events.resize(size + SDL_max(count, 0));
+            if (count < CHUNK) {
+                break;
+            }
+        }
+
+        size_t last = 0;
+        for (size_t i = 0; i < events.size(); i++) {
+            if (events[i].type == get_wake_event()) {
+                wake_pending.store(false, std::memory_order_release);
+                render_partial ? post_frame() : post_redraw();
+                continue;
+            }
+            if (event_coalesce && last > 0 && merge_event(events[last - 1], events[i])) {
+                continue;
+            }
+            events[last++] = events[i];
+        }
+        events.resize(last);
+    }
+
+    // handle events until next (ticks), or a redraw posted in lazy draw mode
+    void wait_events(uint32_t next) {
+        uint32_t now;
+        uint64_t begin = SDL_GetPerformanceCounter();
+
+        while (SDL_WaitEventTimeout(&event, next > (now = get_ticks()) ? next - now : 0)) {
+            stats_wait += SDL_GetPerformanceCounter() - begin;
+
+            collect_events();
+
+            if (events.empty() == false) {
+                if (pacing_idle) {
+                    wake_pacing();      // any input end idle even if on_event() ignore it
+                }
+                frame_changed = true;
+                on_events(events);
+            }
+            
+            if (next_render_time != NEVER || running == false) {
+                return;
+            }
+            begin = SDL_GetPerformanceCounter();
+        }
+        stats_wait += SDL_GetPerformanceCounter() - begin;
+    }
+
+    // run posted tasks until budget (milliseconds) is used, wake next frame if some left
+    void run_tasks(double budget) {
+        SDLAPP_PROFILE_ZONE("tasks");
+
+        const uint64_t begin = SDL_GetPerformanceCounter();
+        const uint64_t limit = (uint64_t) (budget * SDL_GetPerformanceFrequency() / 1000.0);
+
+        sdl_task_queue_t::func_t func;
+        while (tasks.pop(func)) {
+            func();
+
+            if (budget > 0.0 && SDL_GetPerformanceCounter() - begin >= limit) {
+                if (tasks.empty() == false) {
+                    post_wake();
+                }
+                break;
+            }
+        }
+    }
+
+    inline static int64_t get_area(const SDL_Rect& rect) {
+        return (int64_t) rect.w * rect.h;
+    }
+
+    // merge rects when their union waste little area, too many rects become their bounding box
+    void merge_dirty_rects() {
+        static const size_t MAX_RECTS = 8;
+
+        bool merged = true;
+        while (merged) {
+            merged = false;
+            for (size_t i = 0; i < dirty_rects.size(); i++) {
+                for (size_t j = i + 1; j < dirty_rects.size(); j++) {
+                    SDL_Rect rect;
+                    SDL_UnionRect(&dirty_rects[i], &dirty_rects[j], &rect);
+
+                    if (get_area(rect) * 4 <= (get_area(dirty_rects[i]) + get_area(dirty_rects[j])) * 5) {
+                        dirty_rects[i] = rect;
+                        dirty_rects.erase(dirty_rects.begin() + j);
+                        merged = true;
+                        j--;
+                    }
+                }
+            }
+        }
+
+        if (dirty_rects.size() > MAX_RECTS) {
+            for (size_t i = 1; i < dirty_rects.size(); i++) {
+                SDL_UnionRect(&dirty_rects[0], &dirty_rects[i], &dirty_rects[0]);
+            }
+            dirty_rects.resize(1);
+        }
+    }
+
+    void render_dirty(sdl_tick_t now) {
+        SDL_Rect full = {0, 0, window_width, window_height};
+
+        int width = 0, height = 0;
+        if (back_buffer != nullptr) {
+            SDL_QueryTexture(back_buffer, nullptr, nullptr, &width, &height);
+        }
+        if (back_buffer == nullptr || width != window_width || height != window_height) {
+            if (back_buffer != nullptr) {
+                SDL_DestroyTexture(back_buffer);
+            }
+            back_buffer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, window_width, window_height);
+            if (back_buffer == nullptr) {
+                throw sdl_exception_t("failed to create back buffer since %s!", SDL_GetError());
+            }
+            SDL_SetTextureBlendMode(back_buffer, SDL_BLENDMODE_NONE);     // copied over the undefined frame, not blended
+            dirty_full = true;
+        }
+
+        if (dirty_full) {
+            dirty_rects.assign(1, full);
+        }
+        else {
+            merge_dirty_rects();
+        }
+
+        SDL_SetRenderTarget(renderer, back_buffer);
+        for (const SDL_Rect& rect : dirty_rects) {
+            if (SDL_IntersectRect(&rect, &full, &redraw_rect) == SDL_FALSE) {
+                continue;
+            }
+            SDL_RenderSetClipRect(renderer, &redraw_rect);
+            on_render(now);
+        }
+        SDL_RenderSetClipRect(renderer, nullptr);
+        SDL_SetRenderTarget(renderer, nullptr);
+
+        redraw_rect = full;
+        SDL_RenderCopy(renderer, back_buffer, nullptr, nullptr);
+    }
+
+    // == pacing ==
+
+    void update_refresh_rate() {
+        SDL_DisplayMode mode;
+        int index = window ? SDL_GetWindowDisplayIndex(window) : 0;
+        get_current_display_mode(SDL_max(index, 0), &mode);
+
+        pacing_interval = 1000.0 / (mode.refresh_rate > 0 ? mode.refresh_rate : 60);
+    }
+
+    void wake_pacing() {
+        pacing_idle = false;
+        unchanged_frames = 0;
+        next_render_time = 1;
+        pacing_next = get_ticks();
+    }
+
+    // next render time after a frame at now
+    uint32_t pace_frame(uint32_t now) {
+        if (frame_changed) {
+            unchanged_frames = 0;
+        }
+        else {
+            unchanged_frames++;
+        }
+        frame_changed = false;
+
+        if (unchanged_frames >= pacing_idle_frames) {
+            pacing_idle = true;
+            return pacing_idle_delay > 0 ? now + pacing_idle_delay : NEVER;
+        }
+
+        if (pacing_interval <= 0.0) {
+            update_refresh_rate();
+        }
+
+        // skip refreshes rather than tearing the rate when frames are slower than display
+        double interval = pacing_interval * SDL_max(std::ceil(frame_cost / pacing_interval - 0.1), 1.0);
+        pacing_next += interval;
+        if (pacing_next < now) {
+            pacing_next = now;
+        }
+        return (uint32_t) pacing_next;
+    }
+
+    // frame rate and idle ratio, every second
+    void update_frame_stats() {
+        const uint64_t frequency = SDL_GetPerformanceFrequency();
+        uint64_t now = SDL_GetPerformanceCounter();
+
+        if (stats_begin == 0) {
+            stats_begin = now;
+            stats_wait = 0;
+            return;
+        }
+        if (now - stats_begin < frequency) {
+            return;
+        }
+
+        double elapsed = (double) (now - stats_begin);
+        frame_rate = stats_frames * frequency / elapsed;
+        idle_ratio = SDL_min(stats_wait / elapsed, 1.0);
+
+        stats_begin = now;
+        stats_wait = 0;
+        stats_frames = 0;
+    }
+
+
+    void render_frame(sdl_tick_t now, float alpha) {
+        SDLAPP_PROFILE_ZONE("frame");
+        uint64_t begin = SDL_GetPerformanceCounter();
+        render_alpha = alpha;
+        {
+            SDLAPP_PROFILE_ZONE("render");
+            for (sdl_service_t* service : services) {
+                service->on_frame(now);
+            }
+
+            if (render_partial) {
+                render_dirty(now);
+            }
+            else {
+                redraw_rect = {0, 0, window_width, window_height};
+                on_render(now);
+            }
+            dirty_full = false;
+            dirty_rects.clear();
+        }
+
+        // before present, it block until the refresh with vsync, and every frame would look too slow
+        double cost = (SDL_GetPerformanceCounter() - begin) * 1000.0 / SDL_GetPerformanceFrequency();
+        frame_cost = frame_cost > 0.0 ? frame_cost * 0.9 + cost * 0.1 : cost;
+        {
+            SDLAPP_PROFILE_ZONE("present");
+            SDL_RenderPresent(renderer);
+        }
+        stats_frames++;
+
+        sdl_subsystems().require_deferred_sdl();
+    }
+
+    void loop() {
+        uint32_t now;
+
+        while (running) {
+            wait_events(MIN(next_update_time, next_render_time));
+            run_tasks(task_budget);
+            update_frame_stats();
+
+            now = get_ticks();
+
+            // -- handle tick --
+            if (now >= next_update_time) {
+                SDLAPP_PROFILE_ZONE("update");
+                on_update(now);
+                next_update_time = now + update_delay;
+            }
+
+            // -- render --
+            if (render_lazy_draw == true) {
+                if (next_render_time != NEVER) {
+                    render_frame(now, 1.0f);
+                    next_render_time = NEVER;
+                }
+                continue;
+            }
+
+            if (now >= next_render_time) {
+                render_frame(now, 1.0f);
+                next_render_time = pacing ? pace_frame(now) : now + render_delay;
+            }
+        }
+    }
+
+    void loop_fixed() {
+        if (pacing && render_interval <= 0.0) {
+            update_refresh_rate();
+            render_interval = pacing_interval / 1000.0;
+        }
+
+        const double frequency = (double) SDL_GetPerformanceFrequency();
+        const double interval = render_interval > 0.0 ? render_interval : render_delay / 1000.0;
+
+        uint64_t last = SDL_GetPerformanceCounter();
+        double accumulator = 0.0;
+        double render_wait = 0.0;       // seconds until next render
+
+        while (running) {
+            double wait = fixed_step - accumulator;
+            if (render_lazy_draw == false) {
+                wait = SDL_min(wait, render_wait);
+            }
+            // waiting in milliseconds, rounded up rather than spinning on the last one
+            wait_events(get_ticks() + (uint32_t) SDL_max(std::ceil(wait * 1000.0), 0.0));
+            run_tasks(task_budget);
+            update_frame_stats();
+
+            uint64_t counter = SDL_GetPerformanceCounter();
+            double elapsed = (double) (counter - last) / frequency;
+            last = counter;
+
+            accumulator += elapsed;
+            render_wait -= elapsed;
+
+            // -- handle tick --
+            int steps = 0;
+            while (accumulator >= fixed_step && steps < fixed_max_steps) {
+                SDLAPP_PROFILE_ZONE("update");
+                update_count++;
+                on_update((sdl_tick_t) (update_count * fixed_step * 1000.0));
+                accumulator -= fixed_step;
+                steps++;
+            }
+            if (accumulator >= fixed_step) {
+                accumulator = std::fmod(accumulator, fixed_step);      // too slow to catch up, drop them
+            }
+
+            float alpha = (float) (accumulator / fixed_step);
+
+            // -- render --
+            if (render_lazy_draw == true) {
+                if (next_render_time != NEVER) {
+                    render_frame(get_ticks(), alpha);
+                    next_render_time = NEVER;
+                }
+                continue;
+            }
+
+            if (render_wait <= 0.0) {
+                render_frame(get_ticks(), alpha);
+                render_wait += interval;
+                if (render_wait < 0.0) {
+                    render_wait = interval;
+                }
+            }
+        }
+    }
+
+
+public:
+
+    // tasks posted after run() returned are discarded by the queue, members of subclass are gone already
+    ~sdl_window_t() {
+        if (back_buffer != nullptr) {
+            SDL_DestroyTexture(back_buffer);
+        }
+        if (renderer != nullptr) {
+            SDL_DestroyRenderer(renderer);
+        }
+        if (window != nullptr) {
+            SDL_DestroyWindow(window);
+        }
+
+        sdl_subsystems().quit();
+    }
+
+
+    void run() {
+        try {
+            on_setup();
+
+            if (fixed_step > 0.0) {
+                loop_fixed();
+            }
+            else {
+                loop();
+            }
+
+            SDL_Log("app exit normally");
+
+#ifdef SDLAPP_PROFILE
+            if (sdl_profiler().get_trace_file().empty() == false) {
+                sdl_profiler().dump(sdl_profiler().get_trace_file());
+            }
+#endif
+        }
+        catch (sdl_exception_t& e) {
+            std::cerr << e.what() << "\n";
+        }
+        catch (std::exception& e) {
+            SDL_Log("std::exception: %s", e.what());
+        }
+
+        // == wait threads ==
+
+        for (sdl_service_t* service : services) {
+            service->on_stop();
+        }
+
+        jobs.stop();
+
+        for (SDL_Thread* thread : threads) {
+            SDL_WaitThread(thread, nullptr);
+        }
+        threads.clear();
+
+        // nothing post them anymore, and the subclass they capture is still alive
+        run_tasks(0.0);
+    }
+};
+
+
+
+
+
+// == resources ==
+
+// == pool ==
+
+// free lists of small blocks for resource infos, sizes are rounded up to 16 bytes,
+// so each info type get its own size class. blocks are never returned to the system,
+// the pool itself is never destroyed, since resources may be destroyed after static objects.
+class sdl_pool_t {
+    class free_t {
+    public:
+        free_t* next;
+    };
+
+    static constexpr size_t GRAIN = 16;
+    static constexpr size_t CLASSES = 16;       // up to 256 bytes
+    static constexpr size_t CHUNK = 64;         // blocks got from system at once
+
+
+public:
+    class stats_t {
+    public:
+        uint64_t allocs = 0;            // allocate() called
+        uint64_t frees = 0;
+        uint64_t system_allocs = 0;     // operator new called, should stop growing in steady state
+        uint64_t live = 0;
+        uint64_t strings = 0;           // sdl_name_t interned now
+        uint64_t string_allocs = 0;     // new string interned
+    };
+
+private:
+    free_t* heads[CLASSES] = {};
+    SDL_SpinLock lock = 0;
+    stats_t stats;      // written under lock, read by get_stats()
+
+
+public:
+    // == allocate / deallocate ==
+
+    void* allocate(size_t size) {
+        size_t index = (size + GRAIN - 1) / GRAIN - 1;
+
+        SDL_AtomicLock(&lock);
+        stats.allocs++;
+        stats.live++;
+
+        if (index >= CLASSES) {
+            stats.system_allocs++;
+            SDL_AtomicUnlock(&lock);
+            return ::operator new(size);
+        }
+
+        if (heads[index] == nullptr) {
+            size_t block = (index + 1) * GRAIN;
+            char* chunk = (char*) ::operator new(block * CHUNK);
+            stats.system_allocs++;
+
+            for (size_t i = 0; i < CHUNK; i++) {
+                free_t* node = (free_t*) (chunk + i * block);
+                node->next = heads[index];
+                heads[index] = node;
+            }
+        }
+
+        free_t* node = heads[index];
+        heads[index] = node->next;
+        SDL_AtomicUnlock(&lock);
+        return node;
+    }
+
+    void deallocate(void* p, size_t size) {
+        size_t index = (size + GRAIN - 1) / GRAIN - 1;
+
+        SDL_AtomicLock(&lock);
+        stats.frees++;
+        stats.live--;
+
+        if (index >= CLASSES) {
+            SDL_AtomicUnlock(&lock);
+            ::operator delete(p);
+            return;
+        }
+
+        free_t* node = (free_t*) p;
+        node->next = heads[index];
+        heads[index] = node;
+        SDL_AtomicUnlock(&lock);
+    }
+
+
+    // == stats ==
+
+    // count interned strings of sdl_name_t, added is 1 or -1
+    void count_string(int added) {
+        SDL_AtomicLock(&lock);
+        stats.strings += added;
+        if (added > 0) {
+            stats.string_allocs++;
+        }
+        SDL_AtomicUnlock(&lock);
+    }
+
+    stats_t get_stats() {
+        SDL_AtomicLock(&lock);
+        stats_t copy = stats;
+        SDL_AtomicUnlock(&lock);
+        return copy;
+    }
+};
+
+
+inline sdl_pool_t& sdl_pool() {
+    static sdl_pool_t* pool = new sdl_pool_t;
+    return *pool;
+}
+
+// copy of the pool counters
+inline sdl_pool_t::stats_t sdl_pool_stats() {
+    return sdl_pool().get_stats();
+}
+
+
+
+// interned string for file names, same strings share one copy.
+// only for paths, which repeat, a text to render is kept in a plain std::string.
+// copying it only add a reference count, the copy is freed with the last reference.
+class sdl_name_t {
+    using table_t = std::unordered_map<std::string, int>;
+    using node_t = table_t::value_type;
+
+    node_t* node = nullptr;
+
+
+    static table_t& get_table() {
+        static table_t* table = new table_t;        // never destroyed, same as sdl_pool()
+        return *table;
+    }
+
+    static SDL_SpinLock& get_lock() {
+        static SDL_SpinLock lock = 0;
+        return lock;
+    }
+
+    void retain() {
+        if (node) {
+            SDL_AtomicLock(&get_lock());
+            node->second++;
+            SDL_AtomicUnlock(&get_lock());
+        }
+    }
+
+    void drop() {
+        if (node == nullptr) {
+            return;
+        }
+
+        SDL_AtomicLock(&get_lock());
+        if (--node->second == 0) {
+            get_table().erase(get_table().find(node->first));
+            sdl_pool().count_string(-1);
+        }
+        SDL_AtomicUnlock(&get_lock());
+        node = nullptr;
+    }
+
+
+public:
+    sdl_name_t() {}
+
+    sdl_name_t(const std::string& str) {
+        if (str.empty()) {
+            return;
+        }
+
+        SDL_AtomicLock(&get_lock());
+        table_t& table = get_table();
+        auto it = table.find(str);
+        if (it == table.end()) {
+            it = table.emplace(str, 0).first;
+            sdl_pool().count_string(1);
+        }
+        it->second++;
+        node = &*it;
+        SDL_AtomicUnlock(&get_lock());
+    }
+
+    sdl_name_t(const sdl_name_t& other) : node(other.node) {
+        retain();
+    }
+
+    sdl_name_t& operator=(const sdl_name_t& other) {
+        if (node != other.node) {
+            drop();
+            node = other.node;
+            retain();
+        }
+        return *this;
+    }
+
+    ~sdl_name_t() {
+        drop();
+    }
+
+
+    // == get ==
+
+    operator const std::string&() const {
+        static const std::string empty;
+        return node ? node->first : empty;
+    }
+
+    const char* c_str() const {
+        return node ? node->first.c_str() : "";
+    }
+
+    bool empty() const {
+        return node == nullptr;
+    }
+};
+
+
+
+
+// == mapped file ==
+
+// a read only file mapped into memory
+class sdl_mapped_file_t {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+#if defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+public:
+    // == delete ==
+
+    ~sdl_mapped_file_t() {
+        close();
+    }
+
+
+    // == init ==
+
+    sdl_mapped_file_t() {}
+
+    sdl_mapped_file_t(const sdl_mapped_file_t&) = delete;
+    sdl_mapped_file_t& operator=(const sdl_mapped_file_t&) = delete;
+
+
+    // == open / close ==
+
+    // false if the file not exist or it is empty
+    bool open(const std::string& path) {
+        close();
+
+#if defined(_WIN32)
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        LARGE_INTEGER length;
+        if (GetFileSizeEx(file, &length) == FALSE || length.QuadPart == 0) {
+            close();
+            return false;
+        }
+
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            close();
+            return false;
+        }
+
+        data = (const uint8_t*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (data == nullptr) {
+            close();
+            return false;
+        }
+        size = (size_t) length.QuadPart;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+
+        void* view = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (view == MAP_FAILED) {
+            return false;
+        }
+
+        data = (const uint8_t*) view;
+        size = (size_t) info.st_size;
+#endif
+        return true;
+    }
+
+    void close() {
+#if defined(_WIN32)
+        if (data != nullptr) {
+            UnmapViewOfFile(data);
+        }
+        if (mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+        }
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data != nullptr) {
+            munmap((void*) data, size);
+        }
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+
+    // == get / is ==
+
+    inline const uint8_t* get_data() const {
+        return data;
+    }
+
+    inline size_t get_size() const {
+        return size;
+    }
+
+    inline bool is_open() const {
+        return data != nullptr;
+    }
+};
+
+
+
+
+
+// modify time and size of file, false if not exist
+inline bool sdl_get_file_stat(const std::string& file, uint64_t& mtime, uint64_t& size) {
+#if defined(_WIN32)
+    struct _stat64 info;
+    if (_stat64(file.c_str(), &info) != 0) {
+        return false;
+    }
+#else
+    struct stat info;
+    if (stat(file.c_str(), &info) != 0) {
+        return false;
+    }
+#endif
+    mtime = (uint64_t) info.st_mtime;
+    size = (uint64_t) info.st_size;
+    return true;
+}
+
+
+
+
+
+// == pack ==
+
+// many files in one, mapped once and read without copies through SDL_RWFromConstMem.
+//
+// layout, little endian:
+//     header_t
+//     entry_t[slot_count]      open addressing table by fnv-1a hash of name, empty slots have name_size 0
+//     names                    not terminated
+//     blobs                    each one aligned to ALIGNMENT
+//
+// make one by sdl_pack_t::build() or the sdlpack.cpp tool, then sdl_packs().mount() it.
+class sdl_pack_t {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t ALIGNMENT = 64;
+
+    class header_t {
+    public:
+        char magic[8];          // "SDLPACK\0"
+        uint32_t version;
+        uint32_t entry_count;
+        uint32_t slot_count;    // power of 2
+        uint32_t alignment;
+        uint64_t names_offset;
+        uint64_t file_size;
+    };
+
+    class entry_t {
+    public:
+        uint64_t hash;
+        uint64_t offset;
+        uint64_t size;
+        uint32_t name_offset;
+        uint32_t name_size;
+    };
+
+private:
+    std::string file;
+    uint64_t mtime = 0;
+    sdl_mapped_file_t mapped;
+    const header_t* header = nullptr;
+    const entry_t* entries = nullptr;
+    const char* names = nullptr;
+
+
+    // '\\' become '/', leading "./" removed
+    static std::string normalize(const std::string& name) {
+        std::string result = name;
+        std::replace(result.begin(), result.end(), '\\', '/');
+        while (result.compare(0, 2, "./") == 0) {
+            result.erase(0, 2);
+        }
+        return result;
+    }
+
+    static uint32_t get_slot_count(size_t count) {
+        uint32_t slots = 16;
+        while (slots < count * 2) {
+            slots *= 2;
+        }
+        return slots;
+    }
+
+    // table, names and blobs all inside the mapping, checked once at open so find() and reads trust them
+    bool is_valid() const {
+        uint64_t file_size = mapped.get_size();
+        uint32_t slot_count = header->slot_count;
+
+        if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0 || header->entry_count >= slot_count) {
+            return false;
+        }
+        uint64_t table_end = sizeof(header_t) + (uint64_t) sizeof(entry_t) * slot_count;
+        if (table_end > file_size || header->names_offset < table_end || header->names_offset > file_size) {
+            return false;
+        }
+
+        uint64_t names_size = file_size - header->names_offset;
+        uint32_t used = 0;
+        for (uint32_t i = 0; i < slot_count; i++) {
+            const entry_t& entry = entries[i];
+            if (entry.name_size == 0) {
+                continue;
+            }
+            if ((uint64_t) entry.name_offset + entry.name_size > names_size
+                        || entry.offset > file_size || entry.size > file_size - entry.offset) {
+                return false;
+            }
+            used++;
+        }
+        return used == header->entry_count;
+    }
+
+
+public:
+    // == init ==
+
+    sdl_pack_t(const std::string& file) : file(file) {
+        if (mapped.open(file) == false) {
+            throw sdl_exception_t("failed to open pack '%s', maybe the file not exist!", file.c_str());
+        }
+
+        header = (const header_t*) mapped.get_data();
+        if (mapped.get_size() < sizeof(header_t) || memcmp(header->magic, "SDLPACK", 8) != 0
+                    || header->version != VERSION || header->file_size != mapped.get_size()) {
+            throw sdl_exception_t("failed to open pack '%s' since it is broken or not a pack!", file.c_str());
+        }
+
+        entries = (const entry_t*) (header + 1);
+        names = (const char*) mapped.get_data() + header->names_offset;
+
+        if (is_valid() == false) {
+            throw sdl_exception_t("failed to open pack '%s' since it is broken or not a pack!", file.c_str());
+        }
+
+        uint64_t size;
+        sdl_get_file_stat(file, mtime, size);
+    }
+
+    sdl_pack_t(const sdl_pack_t&) = delete;
+    sdl_pack_t& operator=(const sdl_pack_t&) = delete;
+
+
+    // == find ==
+
+    static uint64_t hash(const char* name, size_t size) {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < size; i++) {
+            h = (h ^ (uint8_t) name[i]) * 1099511628211ull;
+        }
+        return h;
+    }
+
+    // the entry of name, or nullptr
+    const entry_t* find(const std::string& name) const {
+        std::string key = normalize(name);
+        uint64_t h = hash(key.data(), key.size());
+        uint32_t mask = header->slot_count - 1;
+
+        uint32_t i = (uint32_t) h & mask;
+        for (uint32_t probes = 0; probes <= mask; probes++, i = (i + 1) & mask) {
+            const entry_t& entry = entries[i];
+            if (entry.name_size == 0) {
+                return nullptr;
+            }
+            if (entry.hash == h && entry.name_size == key.size() && memcmp(names + entry.name_offset, key.data(), key.size()) == 0) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    inline const uint8_t* get_data(const entry_t* entry) const {
+        return mapped.get_data() + entry->offset;
+    }
+
+    // read only stream of name in the mapped pack, or nullptr, the pack must live until it closed.
+    // sdl_packs().open_rw() give streams holding their pack instead.
+    SDL_RWops* open_rw(const std::string& name) const {
+        const entry_t* entry = find(name);
+        if (entry == nullptr) {
+            return nullptr;
+        }
+        return SDL_RWFromConstMem(get_data(entry), (int) entry->size);
+    }
+
+
+    // == get ==
+
+    inline const std::string& get_file() const {
+        return file;
+    }
+
+    inline int get_entry_count() const {
+        return (int) header->entry_count;
+    }
+
+    inline uint64_t get_mtime() const {
+        return mtime;
+    }
+
+
+    // == build ==
+
+    // pack files into file, they are named as given relative to root.
+    static void build(const std::string& file, const std::vector<std::string>& inputs, const std::string& root = "") {
+        std::vector<std::string> keys;
+        std::vector<std::vector<uint8_t>> blobs;
+
+        for (const std::string& input : inputs) {
+            std::string path = root.empty() ? input : root + "/" + input;
+            SDL_RWops* rw = SDL_RWFromFile(path.c_str(), "rb");
+            if (rw == nullptr) {
+                throw sdl_exception_t("failed to pack '%s', maybe the file not exist!", path.c_str());
+            }
+
+            std::vector<uint8_t> blob((size_t) SDL_max(SDL_RWsize(rw), (Sint64) 0));
+            size_t read = blob.empty() ? 0 : SDL_RWread(rw, blob.data(), 1, blob.size());
+            SDL_RWclose(rw);
+            if (read != blob.size()) {
+                throw sdl_exception_t("failed to read '%s' since %s", path.c_str(), SDL_GetError());
+            }
+
+            keys.push_back(normalize(input));
+            blobs.push_back(std::move(blob));
+        }
+
+        header_t header;
+        SDL_zero(header);
+        memcpy(header.magic, "SDLPACK", 8);
+        header.version = VERSION;
+        header.entry_count = (uint32_t) keys.size();
+        header.slot_count = get_slot_count(keys.size());
+        header.alignment = ALIGNMENT;
+        header.names_offset = sizeof(header_t) + sizeof(entry_t) * header.slot_count;
+
+        std::vector<entry_t> slots(header.slot_count);
+        memset(slots.data(), 0, sizeof(entry_t) * slots.size());
+
+        std::string name_data;
+        uint64_t offset = header.names_offset;
+        for (const std::string& key : keys) {
+            offset += key.size();
+        }
+
+        for (size_t i = 0; i < keys.size(); i++) {
+            const std::string& key = keys[i];
+            uint64_t h = hash(key.data(), key.size());
+            uint32_t mask = header.slot_count - 1;
+
+            uint32_t index = (uint32_t) h & mask;
+            while (slots[index].name_size != 0) {
+                if (slots[index].hash == h && name_data.compare(slots[index].name_offset, slots[index].name_size, key) == 0) {
+                    throw sdl_exception_t("failed to pack '%s' since it is added twice!", key.c_str());
+                }
+                index = (index + 1) & mask;
+            }
+
+            offset = (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+            entry_t& entry = slots[index];
+            entry.hash = h;
+            entry.offset = offset;
+            entry.size = blobs[i].size();
+            entry.name_offset = (uint32_t) name_data.size();
+            entry.name_size = (uint32_t) key.size();
+
+            name_data += key;
+            offset += blobs[i].size();
+        }
+        header.file_size = offset;
+
+        // -- write --
+        SDL_RWops* rw = SDL_RWFromFile(file.c_str(), "wb");
+        if (rw == nullptr) {
+            throw sdl_exception_t("failed to create pack '%s' since %s", file.c_str(), SDL_GetError());
+        }
+
+        static const uint8_t zeros[ALIGNMENT] = {};
+        bool ok = SDL_RWwrite(rw, &header, sizeof(header), 1) == 1;
+        ok = ok && SDL_RWwrite(rw, slots.data(), sizeof(entry_t), slots.size()) == slots.size();
+        ok = ok && (name_data.empty() || SDL_RWwrite(rw, name_data.data(), 1, name_data.size()) == name_data.size());
+
+        uint64_t written = header.names_offset + name_data.size();
+        for (size_t i = 0; i < keys.size() && ok; i++) {
+            uint64_t aligned = (written + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+            if (aligned > written) {
+                ok = SDL_RWwrite(rw, zeros, 1, (size_t) (aligned - written)) == aligned - written;
+            }
+            if (ok && blobs[i].empty() == false) {
+                ok = SDL_RWwrite(rw, blobs[i].data(), 1, blobs[i].size()) == blobs[i].size();
+            }
+            written = aligned + blobs[i].size();
+        }
+        SDL_RWclose(rw);
+
+        if (ok == false) {
+            throw sdl_exception_t("failed to write pack '%s' since %s", file.c_str(), SDL_GetError());
+        }
+    }
+};
+
+
+// mounted packs searched by every resource before the file system, the last mounted one first.
+// streams opened by it hold their pack, so a pack unmounted while fonts or music still stream from it
+// stay mapped until the last of them closed.
+class sdl_pack_list_t {
+    // entry of a pack read through SDL_RWops
+    class stream_t {
+    public:
+        std::shared_ptr<sdl_pack_t> pack;
+        const uint8_t* begin;
+        const uint8_t* here;
+        const uint8_t* end;
+    };
+
+    std::vector<std::shared_ptr<sdl_pack_t>> packs;
+    mutable SDL_SpinLock lock = 0;
+
+
+    // == stream ==
+
+    static stream_t* get_stream(SDL_RWops* rw) {
+        return (stream_t*) rw->hidden.unknown.data1;
+    }
+
+    static Sint64 stream_size(SDL_RWops* rw) {
+        stream_t* stream = get_stream(rw);
+        return (Sint64) (stream->end - stream->begin);
+    }
+
+    static Sint64 stream_seek(SDL_RWops* rw, Sint64 offset, int whence) {
+        stream_t* stream = get_stream(rw);
+        Sint64 base;
+        switch (whence) {
+            case RW_SEEK_SET:   base = 0; break;
+            case RW_SEEK_CUR:   base = (Sint64) (stream->here - stream->begin); break;
+            case RW_SEEK_END:   base = (Sint64) (stream->end - stream->begin); break;
+            default:            return SDL_SetError("unknown value for 'whence'");
+        }
+
+        Sint64 position = SDL_min(SDL_max(base + offset, (Sint64) 0), stream_size(rw));
+        stream->here = stream->begin + position;
+        return position;
+    }
+
+    static size_t stream_read(SDL_RWops* rw, void* ptr, size_t size, size_t maxnum) {
+        stream_t* stream = get_stream(rw);
+        if (size == 0) {
+            return 0;
+        }
+
+        size_t count = SDL_min((size_t) (stream->end - stream->here) / size, maxnum);
+        memcpy(ptr, stream->here, count * size);
+        stream->here += count * size;
+        return count;
+    }
+
+    static size_t stream_write(SDL_RWops*, const void*, size_t, size_t) {
+        SDL_SetError("pack stream is read only");
+        return 0;
+    }
+
+    static int stream_close(SDL_RWops* rw) {
+        delete get_stream(rw);
+        SDL_FreeRW(rw);
+        return 0;
+    }
+
+
+public:
+    void mount(const std::string& file) {
+        std::shared_ptr<sdl_pack_t> pack(new sdl_pack_t(file));
+
+        SDL_AtomicLock(&lock);
+        packs.push_back(std::move(pack));
+        SDL_AtomicUnlock(&lock);
+    }
+
+    void unmount(const std::string& file) {
+        std::shared_ptr<sdl_pack_t> pack;       // unmapped out of the lock, if no stream hold it
+
+        SDL_AtomicLock(&lock);
+        for (size_t i = packs.size(); i-- > 0;) {
+            if (packs[i]->get_file() == file) {
+                pack = std::move(packs[i]);
+                packs.erase(packs.begin() + i);
+                break;
+            }
+        }
+        SDL_AtomicUnlock(&lock);
+    }
+
+    // stream of name in the packs, or nullptr
+    SDL_RWops* open_rw(const std::string& name) const {
+        std::shared_ptr<sdl_pack_t> pack;
+        const sdl_pack_t::entry_t* entry = nullptr;
+
+        SDL_AtomicLock(&lock);
+        for (size_t i = packs.size(); i-- > 0 && entry == nullptr;) {
+            entry = packs[i]->find(name);
+            if (entry) {
+                pack = packs[i];
+            }
+        }
+        SDL_AtomicUnlock(&lock);
+
+        if (entry == nullptr) {
+            return nullptr;
+        }
+        SDL_RWops* rw = SDL_AllocRW();
+        if (rw == nullptr) {
+            return nullptr;
+        }
+
+        const uint8_t* data = pack->get_data(entry);
+        rw->size = stream_size;
+        rw->seek = stream_seek;
+        rw->read = stream_read;
+        rw->write = stream_write;
+        rw->close = stream_close;
+        rw->type = SDL_RWOPS_UNKNOWN;
+        rw->hidden.unknown.data1 = new stream_t{std::move(pack), data, data, data + entry->size};
+        return rw;
+    }
+
+    bool has(const std::string& name) const {
+        bool found = false;
+
+        SDL_AtomicLock(&lock);
+        for (size_t i = packs.size(); i-- > 0 && found == false;) {
+            found = packs[i]->find(name) != nullptr;
+        }
+        SDL_AtomicUnlock(&lock);
+        return found;
+    }
+
+    // mtime of the pack and size of name in it, false if not found
+    bool get_stat(const std::string& name, uint64_t& mtime, uint64_t& size) const {
+        bool found = false;
+
+        SDL_AtomicLock(&lock);
+        for (size_t i = packs.size(); i-- > 0 && found == false;) {
+            const sdl_pack_t::entry_t* entry = packs[i]->find(name);
+            if (entry) {
+                mtime = packs[i]->get_mtime();
+                size = entry->size;
+                found = true;
+            }
+        }
+        SDL_AtomicUnlock(&lock);
+        return found;
+    }
+
+    // called by loading jobs while the render thread mount or unmount
+    bool empty() const {
+        SDL_AtomicLock(&lock);
+        bool result = packs.empty();
+        SDL_AtomicUnlock(&lock);
+        return result;
+    }
+};
+
+
+inline sdl_pack_list_t& sdl_packs() {
+    static sdl_pack_list_t packs;
+    return packs;
+}
+
+// stream of file in mounted packs, or from the file system, nullptr if not found.
+// resources load through it, so their names can be pack relative.
+inline SDL_RWops* sdl_open_rw(const std::string& file) {
+    if (sdl_packs().empty() == false) {
+        SDL_RWops* rw = sdl_packs().open_rw(file);
+        if (rw) {
+            return rw;
+        }
+    }
+    return SDL_RWFromFile(file.c_str(), "rb");
+}
+
+// extension as type hint of SDL_image, as IMG_Load() does
+inline const char* sdl_get_file_type(const std::string& file) {
+    size_t dot = file.find_last_of('.');
+    return dot == std::string::npos ? nullptr : file.c_str() + dot + 1;
+}
+
+inline SDL_Surface* sdl_load_surface(const std::string& file) {
+    sdl_subsystems().require_image();
+    return IMG_LoadTyped_RW(sdl_open_rw(file), 1, sdl_get_file_type(file));
+}
+
+inline SDL_Texture* sdl_load_texture(SDL_Renderer* renderer, const std::string& file) {
+    sdl_subsystems().require_image();
+    return IMG_LoadTextureTyped_RW(renderer, sdl_open_rw(file), 1, sdl_get_file_type(file));
+}
+
+inline TTF_Font* sdl_load_font(const std::string& file, int ptsize) {
+    sdl_subsystems().require_ttf();
+    return TTF_OpenFontRW(sdl_open_rw(file), 1, ptsize);
+}
+
+inline Mix_Music* sdl_load_music(const std::string& file) {
+    sdl_subsystems().require_mixer();
+    return Mix_LoadMUS_RW(sdl_open_rw(file), 1);
+}
+
+inline Mix_Chunk* sdl_load_chunk(const std::string& file) {
+    sdl_subsystems().require_mixer();
+    return Mix_LoadWAV_RW(sdl_open_rw(file), 1);
+}
+
+
+
+
+
+// == pixel cache ==
+
+// decoded images kept on disk in the pixel format of renderer, so later launches skip decoding.
+// a cache file is keyed by the source path, and made again when mtime or size of the source changed.
+// textures are uploaded straight from the mapped cache file by SDL_UpdateTexture.
+//
+//     sdl_pixel_cache().enable("cache");      // before loading textures
+class sdl_pixel_cache_t {
+public:
+    static constexpr uint32_t VERSION = 1;
+
+    class header_t {
+    public:
+        char magic[8];              // "SDLPIX\0\0"
+        uint32_t version;
+        uint32_t format;
+        uint64_t source_mtime;
+        uint64_t source_size;
+        int32_t width;
+        int32_t height;
+        int32_t pitch;
+        uint32_t blend;             // 1 if the source has alpha or color key
+        uint32_t path_size;         // the source path follows the header
+        uint32_t pixels_offset;     // aligned to 64
+    };
+
+    class stats_t {
+    public:
+        uint64_t hits = 0;
+        uint64_t misses = 0;        // decoded and saved again
+    };
+
+private:
+    std::string dir;
+    bool enabled = false;
+    std::atomic<uint32_t> format{0};        // 0 until a renderer known, then its preferred format
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+
+
+    static bool get_source_stat(const std::string& file, uint64_t& mtime, uint64_t& size) {
+        if (sdl_packs().get_stat(file, mtime, size)) {
+            return true;
+        }
+        return sdl_get_file_stat(file, mtime, size);
+    }
+
+    // header of the mapped cache of file, nullptr if missing or out of date
+    const header_t* open_cache(const std::string& file, sdl_mapped_file_t& mapped) const {
+        uint64_t mtime, size;
+        if (get_source_stat(file, mtime, size) == false || mapped.open(get_cache_file(file)) == false) {
+            return nullptr;
+        }
+
+        const header_t* header = (const header_t*) mapped.get_data();
+        if (is_valid(header, mapped.get_size()) == false
+                    || header->source_mtime != mtime || header->source_size != size
+                    || header->path_size != file.size() || memcmp(header + 1, file.data(), file.size()) != 0) {
+            mapped.close();
+            return nullptr;
+        }
+        return header;
+    }
+
+    // path and pixels inside size bytes, and a pitch SDL can read width pixels of format from
+    static bool is_valid(const header_t* header, uint64_t size) {
+        if (size < sizeof(header_t) || memcmp(header->magic, "SDLPIX", 7) != 0 || header->version != VERSION) {
+            return false;
+        }
+        if (header->format == 0 || SDL_ISPIXELFORMAT_FOURCC(header->format) || SDL_BYTESPERPIXEL(header->format) == 0) {
+            return false;
+        }
+        if (header->width <= 0 || header->height <= 0
+                    || header->pitch < (int64_t) header->width * SDL_BYTESPERPIXEL(header->format)) {
+            return false;
+        }
+        return sizeof(header_t) + (uint64_t) header->path_size <= header->pixels_offset
+                    && header->pixels_offset + (uint64_t) header->pitch * header->height <= size;
+    }
+
+    // decode file into the cache format and save it, nullptr if decoding failed
+    SDL_Surface* regenerate(const std::string& file, bool& blend) {
+        misses++;
+
+        SDL_Surface* surface = sdl_load_surface(file);
+        if (surface == nullptr) {
+            return nullptr;
+        }
+
+        uint32_t key;
+        blend = SDL_ISPIXELFORMAT_ALPHA(surface->format->format) || SDL_GetColorKey(surface, &key) == 0;
+
+        uint32_t target = format.load(std::memory_order_relaxed);
+        if (target == 0 || (blend && SDL_ISPIXELFORMAT_ALPHA(target) == false)) {
+            target = SDL_PIXELFORMAT_ARGB8888;
+        }
+        if (surface->format->format != target) {
+            SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, target, 0);
+            SDL_FreeSurface(surface);
+            if (converted == nullptr) {
+                return nullptr;
+            }
+            surface = converted;
+        }
+
+        save(file, surface, blend);
+        return surface;
+    }
+
+    // written to a temporary file then renamed, so other threads and processes never read half of it
+    void save(const std::string& file, SDL_Surface* surface, bool blend) const {
+        uint64_t mtime, size;
+        if (get_source_stat(file, mtime, size) == false) {
+            return;
+        }
+
+        header_t header;
+        SDL_zero(header);
+        memcpy(header.magic, "SDLPIX", 7);
+        header.version = VERSION;
+        header.format = surface->format->format;
+        header.source_mtime = mtime;
+        header.source_size = size;
+        header.width = surface->w;
+        header.height = surface->h;
+        header.pitch = surface->pitch;
+        header.blend = blend;
+        header.path_size = (uint32_t) file.size();
+        header.pixels_offset = (uint32_t) ((sizeof(header_t) + file.size() + 63) / 64 * 64);
+
+        std::string cache = get_cache_file(file);
+        std::string temp = cache + "." + std::to_string(SDL_ThreadID()) + ".tmp";
+
+        SDL_RWops* rw = SDL_RWFromFile(temp.c_str(), "wb");
+        if (rw == nullptr) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "failed to save pixel cache of '%s' since %s", file.c_str(), SDL_GetError());
+            return;
+        }
+
+        static const uint8_t zeros[64] = {};
+        size_t padding = header.pixels_offset - sizeof(header_t) - file.size();
+        size_t bytes = (size_t) surface->pitch * surface->h;
+
+        bool ok = SDL_RWwrite(rw, &header, sizeof(header), 1) == 1;
+        ok = ok && SDL_RWwrite(rw, file.data(), 1, file.size()) == file.size();
+        ok = ok && (padding == 0 || SDL_RWwrite(rw, zeros, 1, padding) == padding);
+        ok = ok && SDL_RWwrite(rw, surface->pixels, 1, bytes) == bytes;
+        SDL_RWclose(rw);
+
+        if (ok) {
+#if defined(_WIN32)
+            ::remove(cache.c_str());        // rename() fail there if the target exist, elsewhere it replace atomically
+#endif
+            ok = ::rename(temp.c_str(), cache.c_str()) == 0;
+        }
+        if (ok == false) {
+            ::remove(temp.c_str());
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "failed to save pixel cache of '%s'", file.c_str());
+        }
+    }
+
+
+public:
+    // == enable ==
+
+    // caches are saved in dir, it is made if not exist
+    void enable(const std::string& dir) {
+        this->dir = dir;
+        enabled = true;
+
+#if defined(_WIN32)
+        _mkdir(dir.c_str());
+#else
+        mkdir(dir.c_str(), 0755);
+#endif
+    }
+
+    void disable() {
+        enabled = false;
+    }
+
+    // caches are made in the preferred pixel format of renderer, texture loading set it by itself
+    void set_renderer(SDL_Renderer* renderer) {
+        SDL_RendererInfo info;
+        if (SDL_GetRendererInfo(renderer, &info) == 0 && info.num_texture_formats > 0) {
+            format = info.texture_formats[0];
+        }
+    }
+
+
+    // == load ==
+
+    // texture of file from its cache, which is made if missing or out of date.
+    // it just decode file if not enabled.
+    SDL_Texture* load_texture(SDL_Renderer* renderer, const std::string& file) {
+        if (enabled == false) {
+            return sdl_load_texture(renderer, file);
+        }
+        if (format.load(std::memory_order_relaxed) == 0) {
+            set_renderer(renderer);
+        }
+
+        sdl_mapped_file_t mapped;
+        const header_t* header = open_cache(file, mapped);
+        if (header) {
+            SDL_Texture* texture = SDL_CreateTexture(renderer, header->format, SDL_TEXTUREACCESS_STATIC, header->width, header->height);
+            if (texture) {
+                hits++;
+                SDL_UpdateTexture(texture, nullptr, mapped.get_data() + header->pixels_offset, header->pitch);
+                SDL_SetTextureBlendMode(texture, header->blend ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE);
+                return texture;
+            }
+        }
+
+        bool blend = false;
+        SDL_Surface* surface = regenerate(file, blend);
+        if (surface == nullptr) {
+            return nullptr;
+        }
+
+        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+        if (texture) {
+            SDL_SetTextureBlendMode(texture, blend ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE);
+        }
+        SDL_FreeSurface(surface);
+        return texture;
+    }
+
+    // surface of file from its cache, for loading textures on other threads.
+    // it just decode file if not enabled.
+    SDL_Surface* load_surface(const std::string& file) {
+        if (enabled == false) {
+            return sdl_load_surface(file);
+        }
+
+        bool blend = false;
+        SDL_Surface* surface = nullptr;
+
+        sdl_mapped_file_t mapped;
+        const header_t* header = open_cache(file, mapped);
+        if (header) {
+            SDL_Surface* view = SDL_CreateRGBSurfaceWithFormatFrom(
+                        (void*) (mapped.get_data() + header->pixels_offset), header->width, header->height,
+                        SDL_BITSPERPIXEL(header->format), header->pitch, header->format
+            );
+            if (view) {
+                surface = SDL_DuplicateSurface(view);       // the mapping is closed after return
+                SDL_FreeSurface(view);
+            }
+            if (surface) {
+                hits++;
+                blend = header->blend;
+            }
+        }
+
+        if (surface == nullptr) {
+            surface = regenerate(file, blend);
+        }
+        if (surface) {
+            SDL_SetSurfaceBlendMode(surface, blend ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE);
+        }
+        return surface;
+    }
+
+
+    // == get / is ==
+
+    std::string get_cache_file(const std::string& file) const {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.px", (unsigned long long) sdl_pack_t::hash(file.data(), file.size()));
+        return dir + "/" + name;
+    }
+
+    stats_t get_stats() const {
+        stats_t stats;
+        stats.hits = hits.load();
+        stats.misses = misses.load();
+        return stats;
+    }
+
+    inline bool is_enabled() const {
+        return enabled;
+    }
+};
+
+
+inline sdl_pixel_cache_t& sdl_pixel_cache() {
+    static sdl_pixel_cache_t cache;
+    return cache;
+}
+
+
+
+
+
+// base class for resources, such as texture, font, music, etc.
+// this class designed for private use only
+//
+// threads: handles of any type can be copied and destroyed on any thread, the reference count is atomic.
+// sdl_surface_t, sdl_font_t, sdl_music_t and sdl_chunk_t may be loaded and used on any thread, but one handle by one thread at a time.
+// sdl_texture_t must be loaded and used on the render thread only,
+// when its last handle dropped on another thread, SDL_DestroyTexture is posted to the render thread.
+class sdl_resource_t {
+    friend class sdl_loader_t;
+    friend class sdl_resource_cache_t;
+    friend class sdl_text_pipeline_t;
+
+protected:
+    using release_t = void (*)(void*);
+
+    class basic_info_t {
+    public:
+        int load_method = 0;
+        sdl_name_t file;        // file name, empty if not loaded from file
+
+        void* resource = nullptr;
+        std::atomic<int> use_count{1};
+        bool pending = false;       // loading by sdl_loader_t, only touched on render thread
+
+        virtual ~basic_info_t() {}
+
+        // called when the last handle dropped
+        virtual void destroy(release_t release) noexcept {
+            if (resource != nullptr) {
+                release(resource);
+            }
+            delete this;
+        }
+
+        basic_info_t(void* resource = nullptr, int load_method = 0) : resource(resource), load_method(load_method) {}
+        basic_info_t(const std::string& file, int load_method = 0) : file(file), load_method(load_method) {}
+
+        // infos are created on every handle, take them from sdl_pool()
+        static void* operator new(size_t size) {
+            return sdl_pool().allocate(size);
+        }
+
+        static void operator delete(void* p, size_t size) {
+            sdl_pool().deallocate(p, size);
+        }
+    };
+
+    basic_info_t* ptr;
+
+    
+
+    // == delete / move ==
+
+    static void _ref(basic_info_t* ptr) noexcept {
+        ptr->use_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void _unref(basic_info_t* ptr, release_t release) noexcept {
+        if (ptr->use_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            ptr->destroy(release);
+        }
+    }
+
+    void _delete(release_t release) noexcept {
+        _unref(ptr, release);
+    }
+
+    void _move2(release_t release, const sdl_resource_t& other) noexcept {
+        _ref(other.ptr);        // first, in case of self assignment
+        _delete(release);
+        ptr = other.ptr;
+    }
+
+    void _release(release_t release) const noexcept {
+        if (has_loaded()) {
+            release(ptr->resource);
+            ptr->resource = nullptr;
+        }
+    }
+
+
+    // == init ==
+
+    sdl_resource_t(basic_info_t* ptr)
+    : ptr(ptr) {}
+
+    // constexpr sdl_resource_t() {}
+
+
+
+public:
+    // == copy1 / move1 ==
+
+    sdl_resource_t(const sdl_resource_t& other) noexcept : ptr(other.ptr) {
+        _ref(ptr);
+    }
+
+    sdl_resource_t(sdl_resource_t&& other) noexcept : ptr(other.ptr) {
+        _ref(ptr);
+    }
+
+
+    // == get ==
+
+    const std::string& get_file_name() const {
+        return ptr->file;
+    }
+
+    // == has ==
+
+    bool has_loaded() const {
+        return ptr->resource != nullptr;
+    }
+
+    bool has_pending() const {
+        return ptr->pending;
+    }
+
+    // == compare ==
+
+    // same resource, not same content
+    bool operator==(const sdl_resource_t& other) const {
+        return ptr == other.ptr;
+    }
+
+    bool operator!=(const sdl_resource_t& other) const {
+        return ptr != other.ptr;
+    }
+
+    // == load ==
+
+    virtual void load() const = 0;
+
+    virtual void release() const = 0;
+
+
+    virtual ~sdl_resource_t() {}
+};
+
+
+
+
+
+
+class sdl_font_t : public sdl_resource_t {
+    friend class sdl_loader_t;
+    friend class sdl_text_pipeline_t;
+
+    class info_t : public basic_info_t {
+    public:
+        int ptsize = 0;
+
+        info_t(const std::string& file, int ptsize) : basic_info_t(file), ptsize(ptsize) {}
+        info_t(TTF_Font* font) : basic_info_t((void*) font) {}
+    };
+
+public:
+    // == delete ==
+
+    ~sdl_font_t() {
+        _delete((release_t) TTF_CloseFont);
+    }
+
+    // == init ==
+
+    sdl_font_t(const std::string& file, int ptsize) : sdl_resource_t(new info_t(file, ptsize)) {}
+
+    sdl_font_t(TTF_Font* font = nullptr) : sdl_resource_t(new info_t(font)) {}
+
+
+    // == copy / move ==
+
+    sdl_font_t(const sdl_font_t&) noexcept = default;
+
+    sdl_font_t& operator=(const sdl_font_t& other) noexcept {
+        _move2((release_t) TTF_CloseFont, other);
+        return *this;
+    }
+
+
+    sdl_font_t(sdl_font_t&&) noexcept = default;
+
+    sdl_font_t& operator=(sdl_font_t&& other) noexcept {
+        _move2((release_t) TTF_CloseFont, other);
+        return *this;
+    }
+    
+
+
+    // == get ==
+
+    operator TTF_Font*() const {
+        load();
+        return (TTF_Font*) ptr->resource;
+    }
+
+    int get_size() const {
+        load();
+        return *(int*)(ptr + 1);
+    }
+
+    // == load / release ==
+
+    void load() const {
+        int* ptsize = (int*)(ptr + 1);
+
+        if (has_loaded()) {
+            if (ptsize[0] == 0) {
+                ptsize[0] = TTF_FontHeight((TTF_Font*)ptr->resource);       // some sdl2 version couldn't get font height by TTF_Font
+            }
+            return;
+        }
+        if (ptr->pending) {
+            return;
+        }
+
+        ptr->resource = sdl_load_font(ptr->file, ptsize[0]);
+        if (ptr->resource == nullptr) {
+            throw sdl_exception_t("failed to open font '%s' since %s!", ptr->file.c_str(), TTF_GetError());
+        }
+    }
+
+    void release() const {
+        _release((release_t) TTF_CloseFont);
+    }
+};
+
+
+
+enum sdl_render_text_mode_t {
+    SDLAPP_TEXT_SOLID = 3,
+    SDLAPP_TEXT_BLENDED,
+    SDLAPP_TEXT_SHADED,
+};
+
+
+class sdl_surface_t : public sdl_resource_t {
+    class info_t : public basic_info_t {
+    public:
+        sdl_font_t font;
+        std::string text;
+        SDL_Color fg;
+        SDL_Color bg;
+        uint32_t warp_length;
+
+        info_t(const sdl_font_t& font, const std::string& text, sdl_render_text_mode_t mode, SDL_Color fg, SDL_Color bg, uint32_t warp_length
+        )
+        : basic_info_t(nullptr, mode), font(font), text(text), fg(fg), bg(bg), warp_length(warp_length) {}
+    };
+
+public:
+    // == delete ==
+
+    ~sdl_surface_t() {
+        _delete((release_t) SDL_FreeSurface);
+    }
+
+
+    // == init ==
+
+    sdl_surface_t(const std::string& file) : sdl_resource_t(new basic_info_t(file)) {}
+    sdl_surface_t(SDL_Surface* surface = nullptr) : sdl_resource_t(new basic_info_t(surface)) {}
+
+    sdl_surface_t(
+                const sdl_font_t& font, const std::string& text, sdl_render_text_mode_t mode = SDLAPP_TEXT_SOLID,
+                SDL_Color fg = SDLAPP_COLOR_WHITE, SDL_Color bg = SDLAPP_COLOR_BLACK,
+                uint32_t warp_length = 0
+    ):
+    sdl_resource_t(new info_t(font, text, mode, fg, bg, warp_length)) {}
+
+
+    // == copy / move ==
+
+    sdl_surface_t(const sdl_surface_t& other) noexcept = default;
+
+    sdl_surface_t& operator=(const sdl_surface_t& other) noexcept {
+        _move2((release_t) SDL_DestroyTexture, other);
+        return *this;
+    }
+    
+
+    sdl_surface_t(sdl_surface_t&& other) noexcept = default;
+
+    sdl_surface_t& operator=(sdl_surface_t&& other) noexcept {
+        _move2((release_t) SDL_DestroyTexture, other);
+        return *this;
+    }
+    
+
+
+    // == get ==
+
+    operator SDL_Surface*() const {
+        load();
+        return (SDL_Surface*) ptr->resource;
+    }
+
+    int get_width() const {
+        load();
+        return ((SDL_Surface*) ptr->resource)->w;
+    }
+
+    int get_height() const {
+        load();
+        return ((SDL_Surface*) ptr->resource)->h;
+    }
+
+
+    // == load / release ==
+
+    void load() const {
+        if (has_loaded()) {
+            return;
+        }
+
+        if (ptr->load_method == 0) {
+            ptr->resource = sdl_load_surface(ptr->file);
+
+            if (ptr->resource == nullptr) {
+                throw sdl_exception_t("failed to load texture '%s', maybe the file not exist!", ptr->file.c_str());
+            }
+
+            return;
+        }
+
+        info_t* info = (info_t*) ptr;
+
+        switch (info->load_method) {
+            case SDLAPP_TEXT_SOLID:
+                info->resource = TTF_RenderUTF8_Solid_Wrapped(info->font, info->text.c_str(), info->fg, info->warp_length);
+                break;
+            case SDLAPP_TEXT_BLENDED:
+                info->resource = TTF_RenderUTF8_Blended_Wrapped(info->font, info->text.c_str(), info->fg, info->warp_length);
+                break;
+            case SDLAPP_TEXT_SHADED:
+                info->resource = TTF_RenderUTF8_Shaded_Wrapped(info->font, info->text.c_str(), info->fg, info->bg, info->warp_length);
+                break;
+
+            default:
+                throw sdl_exception_t("invalid text render mode %d!", info->load_method);
+        }
+        if (info->resource == nullptr) {
+            throw sdl_exception_t("failed to render text '%s'!", info->text.c_str());
+        }
+    }
+
+    void release() const {
+        _release((release_t) SDL_FreeSurface);
+    }
+};
+
+
+
+
+
+class sdl_texture_t : public sdl_resource_t {
+    friend class sdl_loader_t;
+    friend class sdl_resource_cache_t;
+    friend class sdl_text_pipeline_t;
+
+    class texture_info_t : public basic_info_t {
+    public:
+        sdl_window_t* owner;
+        int width = 0;
+        int height = 0;
+
+        texture_info_t(void* texture, int load_method, sdl_window_t* owner, int width, int height
+        ):
+        basic_info_t(texture, load_method), owner(owner), width(width), height(height) {}
+
+
+        texture_info_t(const std::string& file, int load_method, sdl_window_t* owner
+        ):
+        basic_info_t(file, load_method), owner(owner) {}
+
+
+        static void destroy_texture(void* info) {
+            ((texture_info_t*) info)->basic_info_t::destroy((release_t) SDL_DestroyTexture);
+        }
+
+        void destroy(release_t release) noexcept override {
+            if (owner->in_render_thread()) {
+                basic_info_t::destroy(release);
+            }
+            else {
+                owner->post_release(destroy_texture, this);
+            }
+        }
+    };
+
+
+    class surface_info_t : public texture_info_t {
+    public:
+        sdl_surface_t surface;
+
+        surface_info_t(
+                    sdl_window_t* owner, const sdl_surface_t& surface
+        ):
+        texture_info_t(nullptr, 1, owner, surface.get_width(), surface.get_height()), surface(surface) {}
+    };
+
+
+    class empty_info_t : public texture_info_t {
+    public:
+        SDL_PixelFormatEnum format;
+        SDL_TextureAccess access;
+        
+        empty_info_t(
+                sdl_window_t* owner, SDL_PixelFormatEnum format, SDL_TextureAccess access,
+                int width, int height
+        ):
+        texture_info_t(nullptr, 2, owner, width, height), format(format), access(access) {}
+    };
+
+    
+    class render_info_t : public texture_info_t {
+    public:
+        sdl_font_t font;
+        std::string text;
+        SDL_Color fg;
+        SDL_Color bg;
+        uint32_t warp_length;
+
+        render_info_t(sdl_window_t* owner, sdl_font_t font, const std::string& text, sdl_render_text_mode_t mode,
+                    SDL_Color fg, SDL_Color bg, uint32_t warp_length
+        ):
+        texture_info_t(nullptr, mode, owner, 0, 0), font(font), text(text), fg(fg), bg(bg), warp_length(warp_length) {}
+    };
+
+public:
+    // == delete ==
+
+    ~sdl_texture_t() {
+        _delete((release_t) SDL_DestroyTexture);
+    }
+
+
+    // == init ==
+
+    sdl_texture_t(sdl_window_t* owner, const std::string& file) : sdl_resource_t(new texture_info_t(file, 0, owner)) {}
+    sdl_texture_t(sdl_window_t* owner, SDL_Texture* texture = nullptr) : sdl_resource_t(new texture_info_t(texture, 0, owner, 0, 0)) {}
+
+
+    sdl_texture_t(sdl_window_t* owner, const sdl_surface_t& surface) : sdl_resource_t(new surface_info_t(owner, surface)) {}
+
+
+    sdl_texture_t(
+                sdl_window_t* owner, SDL_PixelFormatEnum format, SDL_TextureAccess access,
+                int width, int height
+    ):
+    sdl_resource_t(new empty_info_t(owner, format, access, width, height)) {}
+
+
+    sdl_texture_t(
+                sdl_window_t* owner,
+                sdl_font_t font, const std::string& text, sdl_render_text_mode_t mode,
+                SDL_Color fg = SDLAPP_COLOR_WHITE, SDL_Color bg = SDLAPP_COLOR_BLACK, uint32_t warp_length = 0
+    ):
+    sdl_resource_t(new render_info_t(owner, font, text, mode, fg, bg, warp_length)) {}
+
+
+    // == copy ==
+
+    sdl_texture_t(const sdl_texture_t& other) noexcept = default;
+
+    sdl_texture_t& operator=(const sdl_texture_t& other) {
+        if (((texture_info_t*) ptr)->owner != ((texture_info_t*) other.ptr)->owner) {
+            throw std::invalid_argument("couldn't convert texture owned other window!");
+        }
+
+        _move2((release_t) SDL_DestroyTexture, other);
+        return *this;
+    }
+    
+
+    sdl_texture_t(sdl_texture_t&& other) noexcept = default;
+
+    sdl_texture_t& operator=(sdl_texture_t&& other) {
+        if (((texture_info_t*) ptr)->owner != ((texture_info_t*) other.ptr)->owner) {
+            throw std::invalid_argument("couldn't convert texture owned other window!");
+        }
+
+        _move2((release_t) SDL_DestroyTexture, other);
+        return *this;
+    }
+    
+
+
+    // == get ==
+
+    // return the placeholder of sdl_loader_t if it still loading in background.
+    operator SDL_Texture*() const {
+        load();
+        if (ptr->resource == nullptr) {
+            return ((texture_info_t*) ptr)->owner->placeholder_texture;
+        }
+        return (SDL_Texture*) ptr->resource;
+    }
+
+    int get_width() const {
+        load();
+        return ((texture_info_t*) ptr)->width;
+    }
+
+    int get_height() const {
+        load();
+        return ((texture_info_t*) ptr)->height;
+    }
+
+
+    // == load / release ==
+
+    void load() const {
+        if (has_loaded() || ptr->pending) {
+            return;
+        }
+
+        texture_info_t* basic = (texture_info_t*) ptr;
+
+        if (basic->owner->renderer == nullptr) {
+            throw sdl_exception_t("failed to load texture '%s' since renderer still not created!", ptr->file.c_str());
+        }
+
+
+        if (basic->load_method == 0) {
+            basic->resource = sdl_pixel_cache().load_texture(basic->owner->renderer, basic->file);
+
+            if (basic->resource == nullptr) {
+                throw sdl_exception_t("failed to load texture '%s', maybe the file not exist!", basic->file.c_str());
+            }
+
+            SDL_QueryTexture((SDL_Texture*)basic->resource, nullptr, nullptr, &basic->width, &basic->height);
+            return;
+        }
+        if (ptr->load_method == 1) {
+            surface_info_t* info = (surface_info_t*) ptr;
+            info->resource = SDL_CreateTextureFromSurface(basic->owner->renderer, info->surface);
+
+            if (info->resource == nullptr) {
+                throw sdl_exception_t("failed to create texture from surface, %s", SDL_GetError());
+            }
+            info->width = info->surface.get_width();
+            info->height = info->surface.get_height();
+            return;
+        }
+        if (ptr->load_method == 2) {
+            empty_info_t* info = (empty_info_t*) ptr;
+            info->resource = SDL_CreateTexture(basic->owner->renderer, info->format, info->access, info->width, info->height);
+
+            if (info->resource == nullptr) {
+                throw sdl_exception_t("failed to create texture, %s", SDL_GetError());
+            }
+            return;
+        }
+
+        render_info_t* info = (render_info_t*) ptr;
+        if (info->font.has_pending()) {
+            return;
+        }
+
+        sdl_surface_t surface(info->font, info->text, (sdl_render_text_mode_t)info->load_method, info->fg, info->bg, info->warp_length);
+        
+        ptr->resource = SDL_CreateTextureFromSurface(basic->owner->renderer, surface);
+        info->width = surface.get_width();
+        info->height = surface.get_height();
+    }
+
+    void release() const {
+        _release((release_t) SDL_DestroyTexture);
+    }
+};
+
+
+
+
+class sdl_music_t : public sdl_resource_t {
+    friend class sdl_loader_t;
+
+    // the music last started by play()
+    static Mix_Music*& get_last_played() {
+        static Mix_Music* music = nullptr;
+        return music;
+    }
+
+public:
+    // == delete ==
+
+    ~sdl_music_t() {
+        _delete((release_t)Mix_FreeMusic);
+    }
+
+
+    // == init ==
+
+    sdl_music_t(const std::string& file) : sdl_resource_t(new basic_info_t(file)) {}
+    sdl_music_t(Mix_Music* music = nullptr) : sdl_resource_t(new basic_info_t((void*) music)) {}
+
+
+    // == copy / move ==
+
+    sdl_music_t(const sdl_music_t& other) noexcept = default;
+
+    sdl_music_t& operator=(const sdl_music_t& other) noexcept {
+        _move2((release_t) Mix_FreeMusic, other);
+        return *this;
+    }
+    
+
+    sdl_music_t(sdl_music_t&& other) noexcept = default;
+
+    sdl_music_t& operator=(sdl_music_t&& other) noexcept {
+        _move2((release_t) Mix_FreeMusic, other);
+        return *this;
+    }
+    
+
+
+    // == get ==
+
+    operator Mix_Music*() const {
+        load();
+        return (Mix_Music*) ptr->resource;
+    }
+    
+
+    // == play ==
+
+    void play(int loops = 0) const {
+        load();
+        if (ptr->pending) {
+            throw sdl_exception_t("failed to play music '%s' since it still loading!", ptr->file.c_str());
+        }
+        if (Mix_PlayMusic((Mix_Music*) ptr->resource, loops) != 0) {
+            throw sdl_exception_t("failed to play music '%s'!", ptr->file.c_str());
+        }
+        get_last_played() = (Mix_Music*) ptr->resource;
+    }
+
+
+    // == is ==
+
+    bool is_playing() const {
+        return has_loaded() && get_last_played() == ptr->resource && Mix_PlayingMusic();
+    }
+
+
+    // == load / release ==
+
+    void load() const {
+        if (has_loaded() || ptr->pending) {
+            return;
+        }
+
+        ptr->resource = sdl_load_music(ptr->file);
+        if (ptr->resource == nullptr) {
+            throw sdl_exception_t("failed to load music '%s', maybe the file not exist!", ptr->file.c_str());
+        }
+    }
+
+    void release() const {
+        _release((release_t) Mix_FreeMusic);
+    }
+};
+
+
+
+
+// a short sound effect, decoded and converted to the audio device format when loaded,
+// so playing it is only mixing. play it by sdl_voice_manager_t to limit how many play at once.
+class sdl_chunk_t : public sdl_resource_t {
+    friend class sdl_loader_t;
+    friend class sdl_resource_cache_t;
+    friend class sdl_voice_manager_t;
+
+public:
+    // == delete ==
+
+    ~sdl_chunk_t() {
+        _delete((release_t) Mix_FreeChunk);
+    }
+
+
+    // == init ==
+
+    sdl_chunk_t(const std::string& file) : sdl_resource_t(new basic_info_t(file)) {}
+    sdl_chunk_t(Mix_Chunk* chunk = nullptr) : sdl_resource_t(new basic_info_t((void*) chunk)) {}
+
+
+    // == copy / move ==
+
+    sdl_chunk_t(const sdl_chunk_t& other) noexcept = default;
+
+    sdl_chunk_t& operator=(const sdl_chunk_t& other) noexcept {
+        _move2((release_t) Mix_FreeChunk, other);
+        return *this;
+    }
+
+
+    sdl_chunk_t(sdl_chunk_t&& other) noexcept = default;
+
+    sdl_chunk_t& operator=(sdl_chunk_t&& other) noexcept {
+        _move2((release_t) Mix_FreeChunk, other);
+        return *this;
+    }
+
+
+
+    // == get ==
+
+    operator Mix_Chunk*() const {
+        load();
+        return (Mix_Chunk*) ptr->resource;
+    }
+
+    // bytes of decoded samples
+    size_t get_size() const {
+        return has_loaded() ? ((Mix_Chunk*) ptr->resource)->alen : 0;
+    }
+
+
+    // == set ==
+
+    // 0 to MIX_MAX_VOLUME
+    void set_volume(int volume) const {
+        load();
+        Mix_VolumeChunk((Mix_Chunk*) ptr->resource, volume);
+    }
+
+
+    // == play ==
+
+    // play on any free channel, return the channel or -1 if none free
+    int play(int loops = 0) const {
+        load();
+        if (ptr->pending) {
+            throw sdl_exception_t("failed to play chunk '%s' since it still loading!", ptr->file.c_str());
+        }
+        return Mix_PlayChannel(-1, (Mix_Chunk*) ptr->resource, loops);
+    }
+
+
+    // == is ==
+
+    // playing on any channel
+    bool is_playing() const {
+        if (has_loaded() == false) {
+            return false;
+        }
+        int channels = Mix_AllocateChannels(-1);
+        for (int i = 0; i < channels; i++) {
+            if (Mix_Playing(i) && Mix_GetChunk(i) == ptr->resource) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+
+    // == load / release ==
+
+    void load() const {
+        if (has_loaded() || ptr->pending) {
+            return;
+        }
+
+        ptr->resource = sdl_load_chunk(ptr->file);
+        if (ptr->resource == nullptr) {
+            throw sdl_exception_t("failed to load chunk '%s', maybe the file not exist!", ptr->file.c_str());
+        }
+    }
+
+    void release() const {
+        _release((release_t) Mix_FreeChunk);
+    }
+};
+
+
+
+
+// == voices ==
+
+// plays sdl_chunk_t on a fixed pool of mixer channels.
+// play() only queue a request, requests are started together in on_frame(), highest priority first.
+// the same chunk played several times in a frame starts once, at the highest priority and volume of them.
+// when all channels are busy, the voice of lowest priority (the oldest of them) is stopped for a request
+// of no lower priority, or the request is dropped.
+//
+// threads: use it on render thread only.
+//
+//     sdl_voice_manager_t voices{this, 32};
+//     voices.play(snd_hit, 10);
+class sdl_voice_manager_t : public sdl_service_t {
+public:
+    class stats_t {
+    public:
+        uint64_t requests = 0;
+        uint64_t merged = 0;        // requests of a chunk already requested in the frame
+        uint64_t played = 0;
+        uint64_t stolen = 0;        // voices stopped for a higher priority one
+        uint64_t dropped = 0;       // requests found no channel
+    };
+
+private:
+    class request_t {
+    public:
+        sdl_chunk_t chunk;
+        int priority;
+        int volume;
+        int loops;
+    };
+
+    class voice_t {
+    public:
+        sdl_chunk_t chunk;      // keep the chunk alive while playing
+        int priority = 0;
+        uint64_t serial = 0;    // start order
+    };
+
+
+    sdl_window_t* owner;
+    int channel_count;
+    bool allocated = false;
+
+    std::vector<voice_t> voices;
+    std::vector<request_t> requests;
+    std::unordered_map<const void*, size_t> request_index;        // info of chunk -> index of requests
+    uint64_t serial = 0;
+
+    stats_t stats;
+
+
+
+    void allocate() {
+        if (allocated) {
+            return;
+        }
+        sdl_subsystems().require_mixer();
+        Mix_AllocateChannels(channel_count);
+        voices.resize(channel_count);
+        allocated = true;
+    }
+
+    // a free channel, or the one to steal for priority, or -1
+    int find_channel(int priority) {
+        int victim = -1;
+
+        for (int i = 0; i < channel_count; i++) {
+            if (Mix_Playing(i) == 0) {
+                return i;
+            }
+
+            const voice_t& voice = voices[i];
+            if (voice.priority > priority) {
+                continue;
+            }
+            if (victim == -1 || voice.priority < voices[victim].priority ||
+                    (voice.priority == voices[victim].priority && voice.serial < voices[victim].serial)) {
+                victim = i;
+            }
+        }
+
+        if (victim != -1) {
+            Mix_HaltChannel(victim);
+            stats.stolen++;
+        }
+        return victim;
+    }
+
+    void start(request_t& request) {
+        int channel = find_channel(request.priority);
+        if (channel == -1) {
+            stats.dropped++;
+            return;
+        }
+
+        // before playing, or the first samples are mixed at the volume of the last voice
+        Mix_Volume(channel, request.volume);
+        if (Mix_PlayChannel(channel, (Mix_Chunk*) request.chunk.ptr->resource, request.loops) == -1) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "failed to play chunk '%s' since %s",
+                        request.chunk.get_file_name().c_str(), Mix_GetError());
+            stats.dropped++;
+            return;
+        }
+
+        voice_t& voice = voices[channel];
+        voice.chunk = std::move(request.chunk);
+        voice.priority = request.priority;
+        voice.serial = serial++;
+        stats.played++;
+    }
+
+
+public:
+    // == delete ==
+
+    ~sdl_voice_manager_t() {
+        owner->detach_service(this);
+        stop_all();
+    }
+
+
+    // == init ==
+
+    sdl_voice_manager_t(sdl_window_t* owner, int channel_count = 32) : owner(owner), channel_count(channel_count) {
+        owner->attach_service(this);
+    }
+
+    sdl_voice_manager_t(const sdl_voice_manager_t&) = delete;
+    sdl_voice_manager_t& operator=(const sdl_voice_manager_t&) = delete;
+
+
+    // == play ==
+
+    // higher priority steals voices of lower one, volume is 0 to MIX_MAX_VOLUME
+    void play(const sdl_chunk_t& chunk, int priority = 0, int volume = MIX_MAX_VOLUME, int loops = 0) {
+        stats.requests++;
+        if (requests.empty()) {
+            owner->post_frame();        // started in on_frame(), even in lazy draw
+        }
+
+        auto it = request_index.find(chunk.ptr);
+        if (it != request_index.end()) {
+            request_t& request = requests[it->second];
+            request.priority = std::max(request.priority, priority);
+            request.volume = std::max(request.volume, volume);
+            request.loops = request.loops == -1 || loops == -1 ? -1 : std::max(request.loops, loops);      // -1 loops forever
+            stats.merged++;
+            return;
+        }
+
+        request_index[chunk.ptr] = requests.size();
+        requests.push_back({chunk, priority, volume, loops});
+    }
+
+    void stop_all() {
+        requests.clear();
+        request_index.clear();
+
+        if (allocated == false) {
+            return;
+        }
+        Mix_HaltChannel(-1);
+        for (voice_t& voice : voices) {
+            voice.chunk = sdl_chunk_t();
+        }
+    }
+
+
+    // == get ==
+
+    int get_channel_count() const {
+        return channel_count;
+    }
+
+    int get_active_count() const {
+        if (allocated == false) {
+            return 0;
+        }
+        int count = 0;
+        for (int i = 0; i < channel_count; i++) {
+            count += Mix_Playing(i) != 0;
+        }
+        return count;
+    }
+
+    const stats_t& get_stats() const {
+        return stats;
+    }
+
+
+    // == service ==
+
+    void on_frame(sdl_tick_t tick) override {
+        if (requests.empty()) {
+            return;
+        }
+        allocate();
+
+        std::stable_sort(requests.begin(), requests.end(), [](const request_t& a, const request_t& b) {
+            return a.priority > b.priority;
+        });
+
+        for (request_t& request : requests) {
+            try {
+                request.chunk.load();
+            }
+            catch (sdl_exception_t& e) {
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "%s", e.what());
+                stats.dropped++;
+                continue;
+            }
+            if (request.chunk.has_loaded() == false) {
+                stats.dropped++;        // still loading by sdl_loader_t
+                continue;
+            }
+            start(request);
+        }
+
+        requests.clear();
+        request_index.clear();
+    }
+
+    void on_stop() override {
+        stop_all();
+    }
+};
+
+
+
+
+// == soft mixer ==
+
+// mixes many voices in float with sse2 / avx2 kernels, picked at runtime, or plain c++ if neither.
+// each voice has volume, pan and pitch, sounds of any frequency are resampled by linear interpolation,
+// and the sum is added to the output with saturation.
+// start() hook it into sdl_mixer after its own channels, or in place of music if replace_music.
+// the output is mixed in blocks of init_info_t::audio_chunk_size frames, so the callback never allocates.
+//
+// threads: play(), the voice methods and setters lock the audio device while started.
+// play() return a handle of the voice, it does nothing once the voice is reused by another play().
+//
+//     sdl_soft_mixer_t mixer{256};
+//     mixer.start();
+//     auto hit = mixer.load(snd_hit);
+//     auto voice = mixer.play(hit, 0.8f, -0.5f);
+//     mixer.set_voice(voice, 0.8f, 0.5f, 1.0f);
+class sdl_soft_mixer_t {
+public:
+    // samples in float, with one padding frame for interpolation
+    class sound_t {
+    public:
+        std::vector<float> samples;
+        int frames = 0;
+        int channels = 1;       // 1 or 2
+        int frequency = 0;
+
+        sound_t(const float* data, int frames, int channels, int frequency)
+        : samples(data, data + (size_t) frames * channels), frames(frames), channels(channels), frequency(frequency) {
+            samples.resize(samples.size() + channels, 0.0f);
+        }
+    };
+
+    enum kernel_t {
+        KERNEL_SCALAR,
+        KERNEL_SSE2,
+        KERNEL_AVX2,
+    };
+
+    // voice of a play(), index -1 if no voice was free
+    class handle_t {
+    public:
+        int index = -1;
+        uint32_t generation = 0;
+
+        bool is_valid() const {
+            return index >= 0;
+        }
+    };
+
+private:
+    using mix_func_t = void (*)(const float* src, int channels, uint64_t& pos, uint64_t step, float gl, float gr, float* out, int count);
+    using output_func_t = void (*)(const float* mix, uint8_t* stream, int samples);
+
+    static constexpr uint64_t ONE = (uint64_t) 1 << 32;     // positions are 32.32 fixed point frames
+
+    class voice_t {
+    public:
+        std::shared_ptr<const sound_t> sound;       // only reset out of callback
+        uint64_t pos = 0;
+        uint64_t step = ONE;
+        float gain_left = 1.0f;
+        float gain_right = 1.0f;
+        float pitch = 1.0f;
+        bool loop = false;
+        uint32_t generation = 0;        // changed by every play() on it
+        std::atomic<bool> active{false};
+    };
+
+
+    int frequency = MIX_DEFAULT_FREQUENCY;
+    uint16_t format = AUDIO_F32SYS;
+    int channels = 2;
+    int chunk_size = 1024;
+
+    std::vector<voice_t> voices;
+    std::vector<float> mix;         // chunk_size stereo frames
+    float master = 1.0f;
+
+    bool started = false;
+    bool replace_music = false;
+
+    kernel_t kernel = KERNEL_SCALAR;
+    mix_func_t mix_func = mix_scalar;
+    output_func_t output_func = output_f32_scalar;
+
+
+
+    // == scalar kernels ==
+
+    static void mix_scalar(const float* src, int channels, uint64_t& pos, uint64_t step, float gl, float gr, float* out, int count) {
+        for (int j = 0; j < count; j++) {
+            size_t i = (size_t) (pos >> 32);
+            float f = (float) ((uint32_t) pos >> 16) * (1.0f / 65536.0f);
+
+            float l, r;
+            if (channels == 1) {
+                l = r = src[i] + (src[i + 1] - src[i]) * f;
+            }
+            else {
+                l = src[i * 2] + (src[i * 2 + 2] - src[i * 2]) * f;
+                r = src[i * 2 + 1] + (src[i * 2 + 3] - src[i * 2 + 1]) * f;
+            }
+            out[j * 2] += l * gl;
+            out[j * 2 + 1] += r * gr;
+            pos += step;
+        }
+    }
+
+    static void output_s16_scalar(const float* mix, uint8_t* stream, int samples) {
+        int16_t* out = (int16_t*) stream;
+        for (int i = 0; i < samples; i++) {
+            float v = out[i] + mix[i] * 32767.0f;
+            v = std::min(std::max(v, -32768.0f), 32767.0f);
+            out[i] = (int16_t) std::lrint(v);
+        }
+    }
+
+    static void output_f32_scalar(const float* mix, uint8_t* stream, int samples) {
+        float* out = (float*) stream;
+        for (int i = 0; i < samples; i++) {
+            out[i] = std::min(std::max(out[i] + mix[i], -1.0f), 1.0f);
+        }
+    }
+
+
+#if defined(_SDLAPP_X86)
+    // == sse2 kernels ==
+
+    _TARGET_ISA("sse2")
+    static void mix_sse2(const float* src, int channels, uint64_t& pos, uint64_t step, float gl, float gr, float* out, int count) {
+        int j = 0;
+        const __m128 gain = _mm_setr_ps(gl, gr, gl, gr);
+
+        if (step == ONE) {
+            // fraction stays the same, read frames in a row
+            const __m128 f = _mm_set1_ps((float) ((uint32_t) pos >> 16) * (1.0f / 65536.0f));
+            size_t i = (size_t) (pos >> 32);
+
+            if (channels == 2) {
+                for (; j + 2 <= count; j += 2, i += 2) {
+                    __m128 a = _mm_loadu_ps(src + i * 2);
+                    __m128 b = _mm_loadu_ps(src + i * 2 + 2);
+                    __m128 s = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), f));
+                    _mm_storeu_ps(out + j * 2, _mm_add_ps(_mm_loadu_ps(out + j * 2), _mm_mul_ps(s, gain)));
+                }
+            }
+            else {
+                for (; j + 4 <= count; j += 4, i += 4) {
+                    __m128 a = _mm_loadu_ps(src + i);
+                    __m128 b = _mm_loadu_ps(src + i + 1);
+                    __m128 s = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), f));
+                    __m128 lo = _mm_mul_ps(_mm_unpacklo_ps(s, s), gain);
+                    __m128 hi = _mm_mul_ps(_mm_unpackhi_ps(s, s), gain);
+                    _mm_storeu_ps(out + j * 2, _mm_add_ps(_mm_loadu_ps(out + j * 2), lo));
+                    _mm_storeu_ps(out + j * 2 + 4, _mm_add_ps(_mm_loadu_ps(out + j * 2 + 4), hi));
+                }
+            }
+            pos += (uint64_t) j << 32;
+        }
+        else {
+            // resample, gather 4 frames by scalar loads
+            const size_t next = channels;
+            const size_t right = channels - 1;
+            const __m128 scale = _mm_set1_ps(1.0f / 65536.0f);
+
+            for (; j + 4 <= count; j += 4) {
+                const float* p0 = src + (size_t) (pos >> 32) * channels;
+                const float* p1 = src + (size_t) ((pos + step) >> 32) * channels;
+                const float* p2 = src + (size_t) ((pos + step * 2) >> 32) * channels;
+                const float* p3 = src + (size_t) ((pos + step * 3) >> 32) * channels;
+
+                // top 16 bits of the fractions, exact in float
+                __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(_mm_setr_epi32(
+                            (uint32_t) pos >> 16, (uint32_t) (pos + step) >> 16,
+                            (uint32_t) (pos + step * 2) >> 16, (uint32_t) (pos + step * 3) >> 16)), scale);
+                pos += step * 4;
+
+                __m128 a = _mm_setr_ps(p0[0], p1[0], p2[0], p3[0]);
+                __m128 b = _mm_setr_ps(p0[next], p1[next], p2[next], p3[next]);
+                __m128 l = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), f));
+                a = _mm_setr_ps(p0[right], p1[right], p2[right], p3[right]);
+                b = _mm_setr_ps(p0[right + next], p1[right + next], p2[right + next], p3[right + next]);
+                __m128 r = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), f));
+
+                __m128 lo = _mm_mul_ps(_mm_unpacklo_ps(l, r), gain);
+                __m128 hi = _mm_mul_ps(_mm_unpackhi_ps(l, r), gain);
+                _mm_storeu_ps(out + j * 2, _mm_add_ps(_mm_loadu_ps(out + j * 2), lo));
+                _mm_storeu_ps(out + j * 2 + 4, _mm_add_ps(_mm_loadu_ps(out + j * 2 + 4), hi));
+            }
+        }
+
+        mix_scalar(src, channels, pos, step, gl, gr, out + j * 2, count - j);
+    }
+
+    _TARGET_ISA("sse2")
+    static void output_s16_sse2(const float* mix, uint8_t* stream, int samples) {
+        int16_t* out = (int16_t*) stream;
+        const __m128 scale = _mm_set1_ps(32767.0f);
+        const __m128 low = _mm_set1_ps(-32768.0f);
+        const __m128 high = _mm_set1_ps(32767.0f);
+
+        int i = 0;
+        for (; i + 8 <= samples; i += 8) {
+            __m128i x = _mm_loadu_si128((const __m128i*) (out + i));
+            __m128 a = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+            __m128 b = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+            a = _mm_add_ps(a, _mm_mul_ps(_mm_loadu_ps(mix + i), scale));
+            b = _mm_add_ps(b, _mm_mul_ps(_mm_loadu_ps(mix + i + 4), scale));
+            a = _mm_min_ps(_mm_max_ps(a, low), high);
+            b = _mm_min_ps(_mm_max_ps(b, low), high);
+            _mm_storeu_si128((__m128i*) (out + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+        }
+        output_s16_scalar(mix + i, (uint8_t*) (out + i), samples - i);
+    }
+
+    _TARGET_ISA("sse2")
+    static void output_f32_sse2(const float* mix, uint8_t* stream, int samples) {
+        float* out = (float*) stream;
+        const __m128 low = _mm_set1_ps(-1.0f);
+        const __m128 high = _mm_set1_ps(1.0f);
+
+        int i = 0;
+        for (; i + 4 <= samples; i += 4) {
+            __m128 v = _mm_add_ps(_mm_loadu_ps(out + i), _mm_loadu_ps(mix + i));
+            _mm_storeu_ps(out + i, _mm_min_ps(_mm_max_ps(v, low), high));
+        }
+        output_f32_scalar(mix + i, (uint8_t*) (out + i), samples - i);
+    }
+
+
+    // == avx2 kernels ==
+
+    _TARGET_ISA("avx2")
+    static void mix_avx2(const float* src, int channels, uint64_t& pos, uint64_t step, float gl, float gr, float* out, int count) {
+        int j = 0;
+        const __m256 gain = _mm256_setr_ps(gl, gr, gl, gr, gl, gr, gl, gr);
+
+        if (step == ONE) {
+            const __m256 f = _mm256_set1_ps((float) ((uint32_t) pos >> 16) * (1.0f / 65536.0f));
+            size_t i = (size_t) (pos >> 32);
+
+            if (channels == 2) {
+                for (; j + 4 <= count; j += 4, i += 4) {
+                    __m256 a = _mm256_loadu_ps(src + i * 2);
+                    __m256 b = _mm256_loadu_ps(src + i * 2 + 2);
+                    __m256 s = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), f));
+                    _mm256_storeu_ps(out + j * 2, _mm256_add_ps(_mm256_loadu_ps(out + j * 2), _mm256_mul_ps(s, gain)));
+                }
+            }
+            else {
+                for (; j + 8 <= count; j += 8, i += 8) {
+                    __m256 a = _mm256_loadu_ps(src + i);
+                    __m256 b = _mm256_loadu_ps(src + i + 1);
+                    __m256 s = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), f));
+                    __m256 lo = _mm256_unpacklo_ps(s, s);
+                    __m256 hi = _mm256_unpackhi_ps(s, s);
+                    __m256 first = _mm256_mul_ps(_mm256_permute2f128_ps(lo, hi, 0x20), gain);
+                    __m256 second = _mm256_mul_ps(_mm256_permute2f128_ps(lo, hi, 0x31), gain);
+                    _mm256_storeu_ps(out + j * 2, _mm256_add_ps(_mm256_loadu_ps(out + j * 2), first));
+                    _mm256_storeu_ps(out + j * 2 + 8, _mm256_add_ps(_mm256_loadu_ps(out + j * 2 + 8), second));
+                }
+            }
+            pos += (uint64_t) j << 32;
+        }
+        else {
+            // resample, gather 8 frames
+            alignas(32) int index[8];
+            alignas(32) float fr[8];
+            const __m256i next = _mm256_set1_epi32(channels);
+            const __m256i right = _mm256_set1_epi32(channels - 1);
+
+            for (; j + 8 <= count; j += 8) {
+                for (int k = 0; k < 8; k++) {
+                    index[k] = (int) (pos >> 32) * channels;
+                    fr[k] = (float) ((uint32_t) pos >> 16) * (1.0f / 65536.0f);
+                    pos += step;
+                }
+                __m256i vi = _mm256_load_si256((const __m256i*) index);
+                __m256 f = _mm256_load_ps(fr);
+
+                __m256 a = _mm256_i32gather_ps(src, vi, 4);
+                __m256 b = _mm256_i32gather_ps(src, _mm256_add_epi32(vi, next), 4);
+                __m256 l = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), f));
+
+                vi = _mm256_add_epi32(vi, right);
+                a = _mm256_i32gather_ps(src, vi, 4);
+                b = _mm256_i32gather_ps(src, _mm256_add_epi32(vi, next), 4);
+                __m256 r = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), f));
+
+                __m256 lo = _mm256_unpacklo_ps(l, r);
+                __m256 hi = _mm256_unpackhi_ps(l, r);
+                __m256 first = _mm256_mul_ps(_mm256_permute2f128_ps(lo, hi, 0x20), gain);
+                __m256 second = _mm256_mul_ps(_mm256_permute2f128_ps(lo, hi, 0x31), gain);
+                _mm256_storeu_ps(out + j * 2, _mm256_add_ps(_mm256_loadu_ps(out + j * 2), first));
+                _mm256_storeu_ps(out + j * 2 + 8, _mm256_add_ps(_mm256_loadu_ps(out + j * 2 + 8), second));
+            }
+        }
+
+        mix_scalar(src, channels, pos, step, gl, gr, out + j * 2, count - j);
+    }
+
+    _TARGET_ISA("avx2")
+    static void output_s16_avx2(const float* mix, uint8_t* stream, int samples) {
+        int16_t* out = (int16_t*) stream;
+        const __m256 scale = _mm256_set1_ps(32767.0f);
+        const __m256 low = _mm256_set1_ps(-32768.0f);
+        const __m256 high = _mm256_set1_ps(32767.0f);
+
+        int i = 0;
+        for (; i + 16 <= samples; i += 16) {
+            __m256 a = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) (out + i))));
+            __m256 b = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) (out + i + 8))));
+            a = _mm256_add_ps(a, _mm256_mul_ps(_mm256_loadu_ps(mix + i), scale));
+            b = _mm256_add_ps(b, _mm256_mul_ps(_mm256_loadu_ps(mix + i + 8), scale));
+            a = _mm256_min_ps(_mm256_max_ps(a, low), high);
+            b = _mm256_min_ps(_mm256_max_ps(b, low), high);
+
+            // packs works in 128 bit lanes, put the quarters back in order
+            __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+            _mm256_storeu_si256((__m256i*) (out + i), _mm256_permute4x64_epi64(packed, 0xd8));
+        }
+        output_s16_scalar(mix + i, (uint8_t*) (out + i), samples - i);
+    }
+
+    _TARGET_ISA("avx2")
+    static void output_f32_avx2(const float* mix, uint8_t* stream, int samples) {
+        float* out = (float*) stream;
+        const __m256 low = _mm256_set1_ps(-1.0f);
+        const __m256 high = _mm256_set1_ps(1.0f);
+
+        int i = 0;
+        for (; i + 8 <= samples; i += 8) {
+            __m256 v = _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_loadu_ps(mix + i));
+            _mm256_storeu_ps(out + i, _mm256_min_ps(_mm256_max_ps(v, low), high));
+        }
+        output_f32_scalar(mix + i, (uint8_t*) (out + i), samples - i);
+    }
+#endif
+
+
+
+    // == mix ==
+
+    static void callback(void* data, uint8_t* stream, int len) {
+        ((sdl_soft_mixer_t*) data)->process(stream, len);
+    }
+
+    void mix_voice(voice_t& voice, float* out, int count) {
+        const sound_t& sound = *voice.sound;
+        const uint64_t end = (uint64_t) sound.frames << 32;
+        float gl = voice.gain_left * master;
+        float gr = voice.gain_right * master;
+
+        while (count > 0 && voice.active) {
+            int n = (int) std::min<uint64_t>(count, (end - voice.pos + voice.step - 1) / voice.step);
+            mix_func(sound.samples.data(), sound.channels, voice.pos, voice.step, gl, gr, out, n);
+            out += n * 2;
+            count -= n;
+
+            if (voice.pos >= end) {
+                if (voice.loop) {
+                    voice.pos %= end;
+                }
+                else {
+                    voice.active = false;
+                }
+            }
+        }
+    }
+
+    void update_step(voice_t& voice) {
+        voice.step = (uint64_t) ((double) voice.sound->frequency / frequency * voice.pitch * ONE);
+        voice.step = std::max<uint64_t>(voice.step, 1);
+    }
+
+    // the voice of handle, nullptr if the handle is stale
+    voice_t* find_voice(handle_t handle) {
+        if (handle.index < 0 || handle.index >= (int) voices.size() || voices[handle.index].generation != handle.generation) {
+            return nullptr;
+        }
+        return &voices[handle.index];
+    }
+
+    // called with the device locked
+    void select_kernel(kernel_t kernel) {
+        bool s16 = format == AUDIO_S16SYS;
+
+#if defined(_SDLAPP_X86)
+        if (kernel == KERNEL_AVX2 && SDL_HasAVX2()) {
+            this->kernel = KERNEL_AVX2;
+            mix_func = mix_avx2;
+            output_func = s16 ? output_s16_avx2 : output_f32_avx2;
+            return;
+        }
+        if (kernel >= KERNEL_SSE2 && SDL_HasSSE2()) {
+            this->kernel = KERNEL_SSE2;
+            mix_func = mix_sse2;
+            output_func = s16 ? output_s16_sse2 : output_f32_sse2;
+            return;
+        }
+#endif
+
+        this->kernel = KERNEL_SCALAR;
+        mix_func = mix_scalar;
+        output_func = s16 ? output_s16_scalar : output_f32_scalar;
+    }
+
+    void lock() {
+        if (started) {
+            Mix_LockAudio();
+        }
+    }
+
+    void unlock() {
+        if (started) {
+            Mix_UnlockAudio();
+        }
+    }
+
+
+public:
+    // == delete ==
+
+    ~sdl_soft_mixer_t() {
+        stop();
+    }
+
+
+    // == init ==
+
+    sdl_soft_mixer_t(int voice_count = 256) : voices(voice_count) {
+        set_kernel(KERNEL_AVX2);
+        set_format(frequency, format, channels, chunk_size);
+    }
+
+    sdl_soft_mixer_t(const sdl_soft_mixer_t&) = delete;
+    sdl_soft_mixer_t& operator=(const sdl_soft_mixer_t&) = delete;
+
+
+    // == start / stop ==
+
+    // hook into the opened audio device, false if its format not supported
+    bool start(bool replace_music = false) {
+        if (started) {
+            return true;
+        }
+        sdl_subsystems().require_mixer();
+
+        int device_frequency = 0;
+        uint16_t device_format = 0;
+        int device_channels = 0;
+        if (Mix_QuerySpec(&device_frequency, &device_format, &device_channels) == 0) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "failed to start soft mixer since audio not opened");
+            return false;
+        }
+        if (set_format(device_frequency, device_format, device_channels, sdl_subsystems().get_audio_chunk_size()) == false) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "failed to start soft mixer since audio format 0x%x, %d channels not supported",
+                        device_format, device_channels);
+            return false;
+        }
+
+        this->replace_music = replace_music;
+        if (replace_music) {
+            Mix_HookMusic(callback, this);
+        }
+        else {
+            Mix_SetPostMix(callback, this);
+        }
+        started = true;
+        return true;
+    }
+
+    void stop() {
+        if (started == false) {
+            return;
+        }
+        if (replace_music) {
+            Mix_HookMusic(nullptr, nullptr);
+        }
+        else {
+            Mix_SetPostMix(nullptr, nullptr);
+        }
+        started = false;
+    }
+
+
+    // == sound ==
+
+    // convert a chunk, which is in the format of the opened device, to a sound.
+    // nullptr if the chunk is still loading or failed, or the device format not supported.
+    std::shared_ptr<sound_t> load(const sdl_chunk_t& chunk) {
+        if (chunk.has_pending()) {
+            return nullptr;
+        }
+        Mix_Chunk* data = chunk;
+        if (data == nullptr) {
+            return nullptr;
+        }
+
+        int device_frequency = 0;
+        uint16_t device_format = 0;
+        int device_channels = 0;
+        if (Mix_QuerySpec(&device_frequency, &device_format, &device_channels) == 0
+                    || (device_format != AUDIO_S16SYS && device_format != AUDIO_F32SYS) || device_channels < 1 || device_channels > 2) {
+            SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "failed to load chunk '%s' into soft mixer since audio not opened or not supported",
+                        chunk.get_file_name().c_str());
+            return nullptr;
+        }
+
+        int bytes = device_format == AUDIO_S16SYS ? 2 : 4;
+        int frames = (int) (data->alen / (bytes * device_channels));
+        std::vector<float> samples((size_t) frames * device_channels);
+
+        for (size_t i = 0; i < samples.size(); i++) {
+            samples[i] = bytes == 2 ? ((int16_t*) data->abuf)[i] * (1.0f / 32768.0f) : ((float*) data->abuf)[i];
+        }
+        return std::make_shared<sound_t>(samples.data(), frames, device_channels, device_frequency);
+    }
+
+
+    // == play ==
+
+    // volume 0 to 1, pan -1 (left) to 1 (right), pitch 1 is the original speed.
+    // return the voice, not valid if all voices busy
+    handle_t play(const std::shared_ptr<const sound_t>& sound, float volume = 1.0f, float pan = 0.0f, float pitch = 1.0f, bool loop = false) {
+        if (sound == nullptr || sound->frames == 0) {
+            return handle_t();
+        }
+
+        for (int i = 0; i < (int) voices.size(); i++) {
+            voice_t& voice = voices[i];
+            if (voice.active) {
+                continue;
+            }
+
+            voice.sound = sound;        // may free the last sound of the voice, so out of lock
+            voice.pos = 0;
+            voice.pitch = pitch;
+            voice.loop = loop;
+            update_step(voice);
+            voice.gain_left = volume * std::min(1.0f, 1.0f - pan);
+            voice.gain_right = volume * std::min(1.0f, 1.0f + pan);
+            voice.generation++;
+
+            lock();
+            voice.active = true;
+            unlock();
+            return handle_t{i, voice.generation};
+        }
+        return handle_t();
+    }
+
+    // nothing if the voice is reused by another play()
+    void set_voice(handle_t handle, float volume, float pan, float pitch) {
+        voice_t* voice = find_voice(handle);
+        if (voice == nullptr) {
+            return;
+        }
+
+        lock();
+        voice->gain_left = volume * std::min(1.0f, 1.0f - pan);
+        voice->gain_right = volume * std::min(1.0f, 1.0f + pan);
+        if (voice->sound) {
+            voice->pitch = pitch;
+            update_step(*voice);
+        }
+        unlock();
+    }
+
+    void stop_voice(handle_t handle) {
+        voice_t* voice = find_voice(handle);
+        if (voice == nullptr) {
+            return;
+        }
+
+        lock();
+        voice->active = false;
+        unlock();
+    }
+
+    void stop_all() {
+        lock();
+        for (voice_t& voice : voices) {
+            voice.active = false;
+        }
+        unlock();
+    }
+
+
+    // == mix ==
+
+    // add all voices to stream, called by the audio callback, or directly when not started
+    void process(uint8_t* stream, int len) {
+        int frame_bytes = channels * (format == AUDIO_S16SYS ? 2 : 4);
+        int frames = len / frame_bytes;
+
+        while (frames > 0) {
+            int n = std::min(frames, chunk_size);
+            std::fill(mix.begin(), mix.begin() + n * 2, 0.0f);
+
+            for (voice_t& voice : voices) {
+                if (voice.active) {
+                    mix_voice(voice, mix.data(), n);
+                }
+            }
+
+            if (channels == 1) {
+                for (int i = 0; i < n; i++) {
+                    mix[i] = (mix[i * 2] + mix[i * 2 + 1]) * 0.5f;
+                }
+            }
+            output_func(mix.data(), stream, n * channels);
+
+            stream += n * frame_bytes;
+            frames -= n;
+        }
+    }
+
+
+    // == set ==
+
+    // the output format, done by start(). false if not AUDIO_S16SYS or AUDIO_F32SYS, 1 or 2 channels
+    bool set_format(int frequency, uint16_t format, int channels, int chunk_size) {
+        if ((format != AUDIO_S16SYS && format != AUDIO_F32SYS) || channels < 1 || channels > 2 || chunk_size <= 0) {
+            return false;
+        }
+
+        lock();
+        this->frequency = frequency;
+        this->format = format;
+        this->channels = channels;
+        this->chunk_size = chunk_size;
+        mix.assign((size_t) chunk_size * 2, 0.0f);
+
+        for (voice_t& voice : voices) {
+            if (voice.sound) {
+                update_step(voice);
+            }
+        }
+        select_kernel(kernel);
+        unlock();
+        return true;
+    }
+
+    // use the kernel, or the best one below it the cpu supports
+    void set_kernel(kernel_t kernel) {
+        lock();
+        select_kernel(kernel);
+        unlock();
+    }
+
+    // volume of all voices, 0 to 1
+    void set_master_volume(float volume) {
+        lock();
+        master = volume;
+        unlock();
+    }
+
+
+    // == get ==
+
+    kernel_t get_kernel() const {
+        return kernel;
+    }
+
+    const char* get_kernel_name() const {
+        static const char* names[] = {"scalar", "sse2", "avx2"};
+        return names[kernel];
+    }
+
+    int get_voice_count() const {
+        return (int) voices.size();
+    }
+
+    int get_active_count() const {
+        int count = 0;
+        for (const voice_t& voice : voices) {
+            count += voice.active;
+        }
+        return count;
+    }
+
+    int get_chunk_size() const {
+        return chunk_size;
+    }
+
+    bool is_started() const {
+        return started;
+    }
+};
+
+
+
+
+// == loader ==
+
+// load texture / font / music / chunk, or render text, in background.
+// files are decoded and texts rendered by jobs on sdl_window_t::jobs,
+// then finished on render thread in on_frame(), at most upload_budget textures every frame.
+// while loading, has_pending() of the resource is true and texture return a placeholder.
+//
+//     sdl_loader_t loader{this};
+//     loader.request(img_titi);
+class sdl_loader_t : public sdl_service_t {
+    using basic_info_t = sdl_resource_t::basic_info_t;
+    using text_info_t = sdl_texture_t::render_info_t;
+
+    enum kind_t {
+        KIND_TEXTURE,
+        KIND_FONT,
+        KIND_MUSIC,
+        KIND_CHUNK,
+        KIND_TEXT,
+    };
+
+    class job_t {
+    public:
+        kind_t kind;
+        basic_info_t* info;     // only touched on render thread
+        sdl_name_t file;        // font file of text
+        int ptsize;
+
+        // text, the font is opened again by workers with the same settings
+        std::string text;
+        sdl_render_text_mode_t mode = SDLAPP_TEXT_BLENDED;
+        SDL_Color fg{0, 0, 0, 0}, bg{0, 0, 0, 0};
+        uint32_t warp_length = 0;
+        int style = 0;
+        int hinting = 0;
+        int outline = 0;
+        int kerning = 1;
+
+        void* result = nullptr;
+
+        job_t(kind_t kind, basic_info_t* info, const sdl_name_t& file, int ptsize) : kind(kind), info(info), file(file), ptsize(ptsize) {}
+    };
+
+    // fonts opened for texts by one worker, a TTF_Font can't be used by two threads at once.
+    // the last slot is shared by threads helping in sdl_job_system_t::wait().
+    class slot_t {
+    public:
+        SDL_mutex* mutex = nullptr;
+        std::unordered_map<std::string, TTF_Font*> fonts;      // "ptsize:file"
+    };
+
+
+    sdl_window_t* owner;
+    int upload_budget;
+
+    SDL_mutex* mutex = nullptr;
+    SDL_mutex* font_mutex = nullptr;
+
+    std::deque<job_t*> done;
+    sdl_job_group_t group;
+    std::vector<std::unique_ptr<slot_t>> slots;
+
+    int in_flight = 0;
+
+    sdl_texture_t placeholder;
+    bool placeholder_created = false;
+
+
+
+    // == worker ==
+
+    void run(job_t* job) {
+        decode(job);
+
+        SDL_LockMutex(mutex);
+        done.push_back(job);
+        SDL_UnlockMutex(mutex);
+        owner->post_wake();
+    }
+
+    void decode(job_t* job) {
+        switch (job->kind) {
+            case KIND_TEXTURE:
+                job->result = sdl_pixel_cache().load_surface(job->file);
+                break;
+
+            case KIND_FONT:
+                job->result = open_font(job->file, job->ptsize);
+                break;
+
+            case KIND_MUSIC:
+                job->result = sdl_load_music(job->file);
+                break;
+
+            case KIND_CHUNK:
+                job->result = sdl_load_chunk(job->file);
+                break;
+
+            case KIND_TEXT:
+                render_text(job);
+                break;
+        }
+    }
+
+    TTF_Font* open_font(const std::string& file, int ptsize) {
+        // freetype library is shared by all fonts, don't open them at same time.
+        SDL_LockMutex(font_mutex);
+        TTF_Font* font = sdl_load_font(file, ptsize);
+        SDL_UnlockMutex(font_mutex);
+        return font;
+    }
+
+    void render_text(job_t* job) {
+        int index = owner->jobs.get_worker_index();
+        slot_t& slot = *slots[index >= 0 ? index : slots.size() - 1];
+
+        SDL_LockMutex(slot.mutex);
+
+        std::string key = std::to_string(job->ptsize) + ":" + (const std::string&) job->file;
+        auto it = slot.fonts.find(key);
+        if (it == slot.fonts.end()) {
+            it = slot.fonts.emplace(key, open_font(job->file, job->ptsize)).first;
+        }
+
+        TTF_Font* font = it->second;
+        if (font != nullptr) {
+            // setting them flush the glyph cache of the font, only do it if changed
+            if (TTF_GetFontStyle(font) != job->style) {
+                TTF_SetFontStyle(font, job->style);
+            }
+            if (TTF_GetFontHinting(font) != job->hinting) {
+                TTF_SetFontHinting(font, job->hinting);
+            }
+            if (TTF_GetFontOutline(font) != job->outline) {
+                TTF_SetFontOutline(font, job->outline);
+            }
+            if (TTF_GetFontKerning(font) != job->kerning) {
+                TTF_SetFontKerning(font, job->kerning);
+            }
+
+            switch (job->mode) {
+                case SDLAPP_TEXT_SOLID:
+                    job->result = TTF_RenderUTF8_Solid_Wrapped(font, job->text.c_str(), job->fg, job->warp_length);
+                    break;
+                case SDLAPP_TEXT_BLENDED:
+                    job->result = TTF_RenderUTF8_Blended_Wrapped(font, job->text.c_str(), job->fg, job->warp_length);
+                    break;
+                case SDLAPP_TEXT_SHADED:
+                    job->result = TTF_RenderUTF8_Shaded_Wrapped(font, job->text.c_str(), job->fg, job->bg, job->warp_length);
+                    break;
+            }
+        }
+
+        SDL_UnlockMutex(slot.mutex);
+    }
+
+
+
+    // == render thread ==
+
+    static sdl_resource_t::release_t get_release(kind_t kind) {
+        switch (kind) {
+            case KIND_TEXTURE:  return (sdl_resource_t::release_t) SDL_DestroyTexture;
+            case KIND_TEXT:     return (sdl_resource_t::release_t) SDL_DestroyTexture;
+            case KIND_FONT:     return (sdl_resource_t::release_t) TTF_CloseFont;
+            case KIND_CHUNK:    return (sdl_resource_t::release_t) Mix_FreeChunk;
+            default:            return (sdl_resource_t::release_t) Mix_FreeMusic;
+        }
+    }
+
+    static bool is_texture(kind_t kind) {
+        return kind == KIND_TEXTURE || kind == KIND_TEXT;
+    }
+
+    static void free_result(job_t* job) {
+        if (job->result == nullptr) {
+            return;
+        }
+        if (is_texture(job->kind)) {
+            SDL_FreeSurface((SDL_Surface*) job->result);
+        }
+        else {
+            get_release(job->kind)(job->result);
+        }
+        job->result = nullptr;
+    }
+
+    void discard(job_t* job) {
+        free_result(job);
+        job->info->pending = false;
+        sdl_resource_t::_unref(job->info, get_release(job->kind));
+        delete job;
+    }
+
+    void finish(job_t* job) {
+        basic_info_t* info = job->info;
+        in_flight--;
+
+        if (job->result == nullptr) {
+            if (job->kind == KIND_TEXT) {
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "failed to render text '%s' in background", job->text.c_str());
+            }
+            else {
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "failed to load '%s' in background", job->file.c_str());
+            }
+            discard(job);
+            return;
+        }
+        if (info->use_count.load(std::memory_order_acquire) == 1 || info->resource != nullptr) {
+            discard(job);       // nobody use it anymore
+            return;
+        }
+
+        if (is_texture(job->kind)) {
+            SDL_Surface* surface = (SDL_Surface*) job->result;
+            sdl_texture_t::texture_info_t* texture_info = (sdl_texture_t::texture_info_t*) info;
+
+            info->resource = SDL_CreateTextureFromSurface(owner->renderer, surface);
+            if (info->resource == nullptr) {
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "failed to create texture '%s' since %s", job->file.c_str(), SDL_GetError());
+            }
+            else {
+                texture_info->width = surface->w;
+                texture_info->height = surface->h;
+            }
+            SDL_FreeSurface(surface);
+        }
+        else {
+            info->resource = job->result;
+        }
+
+        job->result = nullptr;
+        discard(job);
+    }
+
+    void create_placeholder() {
+        if (placeholder_created || owner->placeholder_texture != nullptr || owner->renderer == nullptr) {
+            return;
+        }
+
+        // 2x2 magenta / black checker
+        static const uint32_t pixels[4] = {0xffff00ff, 0xff000000, 0xff000000, 0xffff00ff};
+
+        placeholder = sdl_texture_t(owner, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, 2, 2);
+        SDL_UpdateTexture(placeholder, nullptr, pixels, 2 * sizeof(uint32_t));
+        owner->placeholder_texture = placeholder;
+        placeholder_created = true;
+    }
+
+    void start() {
+        if (mutex != nullptr) {
+            return;
+        }
+
+        mutex = SDL_CreateMutex();
+        font_mutex = SDL_CreateMutex();
+        if (mutex == nullptr || font_mutex == nullptr) {
+            throw sdl_exception_t("failed to create loader since %s", SDL_GetError());
+        }
+    }
+
+    void post(job_t* job) {
+        job->info->pending = true;
+        sdl_resource_t::_ref(job->info);
+        in_flight++;
+
+        owner->jobs.post(group, [this, job]() {
+            run(job);
+        });
+    }
+
+    void request_file(kind_t kind, basic_info_t* info, int ptsize = 0) {
+        if (info->resource != nullptr || info->pending || info->file.empty()) {
+            return;
+        }
+        start();
+        create_placeholder();
+
+        post(new job_t(kind, info, info->file, ptsize));
+    }
+
+
+protected:
+    // text texture rendered by a job, see sdl_text_pipeline_t
+    sdl_texture_t request_text(
+                const sdl_font_t& font, const std::string& text, sdl_render_text_mode_t mode,
+                SDL_Color fg, SDL_Color bg, uint32_t warp_length
+    ) {
+        sdl_texture_t texture(owner, font, text, mode, fg, bg, warp_length);
+        if (font.ptr->file.empty() || font.has_pending() || text.empty()) {
+            return texture;     // font made from TTF_Font* or still loading, load when used
+        }
+        font.load();        // settings of it are copied to workers
+        start();
+        create_placeholder();
+
+        if (slots.empty()) {
+            for (int i = 0; i <= owner->jobs.get_worker_count(); i++) {
+                slots.emplace_back(new slot_t);
+                slots.back()->mutex = SDL_CreateMutex();
+                if (slots.back()->mutex == nullptr) {
+                    throw sdl_exception_t("failed to create loader since %s", SDL_GetError());
+                }
+            }
+        }
+
+        text_info_t* info = (text_info_t*) texture.ptr;
+        TTF_Font* ttf = (TTF_Font*) font.ptr->resource;
+
+        job_t* job = new job_t(KIND_TEXT, info, font.ptr->file, ((sdl_font_t::info_t*) font.ptr)->ptsize);
+        job->text = info->text;
+        job->mode = (sdl_render_text_mode_t) info->load_method;
+        job->fg = info->fg;
+        job->bg = info->bg;
+        job->warp_length = info->warp_length;
+        job->style = TTF_GetFontStyle(ttf);
+        job->hinting = TTF_GetFontHinting(ttf);
+        job->outline = TTF_GetFontOutline(ttf);
+        job->kerning = TTF_GetFontKerning(ttf);
+
+        post(job);
+        return texture;
+    }
+
+
+public:
+    // == delete ==
+
+    ~sdl_loader_t() {
+        owner->detach_service(this);
+
+        if (mutex != nullptr) {
+            owner->jobs.wait(group);
+
+            for (job_t* job : done) {
+                discard(job);
+            }
+
+            for (auto& slot : slots) {
+                for (auto& font : slot->fonts) {
+                    if (font.second) {
+                        TTF_CloseFont(font.second);
+                    }
+                }
+                SDL_DestroyMutex(slot->mutex);
+            }
+
+            SDL_DestroyMutex(font_mutex);
+            SDL_DestroyMutex(mutex);
+        }
+
+        if (placeholder_created) {
+            owner->placeholder_texture = nullptr;
+        }
+    }
+
+
+    // == init ==
+
+    sdl_loader_t(sdl_window_t* owner, int upload_budget = 4)
+    : owner(owner), upload_budget(upload_budget), placeholder(owner) {
+        owner->attach_service(this);
+    }
+
+    sdl_loader_t(const sdl_loader_t&) = delete;
+    sdl_loader_t& operator=(const sdl_loader_t&) = delete;
+
+
+    // == request ==
+
+    void request(const sdl_texture_t& texture) {
+        if (texture.ptr->load_method != 0) {
+            texture.load();     // made from surface or text, nothing to read from disk
+            return;
+        }
+        request_file(KIND_TEXTURE, texture.ptr);
+    }
+
+    void request(const sdl_font_t& font) {
+        request_file(KIND_FONT, font.ptr, ((sdl_font_t::info_t*) font.ptr)->ptsize);
+    }
+
+    // audio is opened here if deferred, not on workers
+    void request(const sdl_music_t& music) {
+        sdl_subsystems().require_mixer();
+        request_file(KIND_MUSIC, music.ptr);
+    }
+
+    void request(const sdl_chunk_t& chunk) {
+        sdl_subsystems().require_mixer();
+        request_file(KIND_CHUNK, chunk.ptr);
+    }
+
+
+    // == set ==
+
+    // replace the default checker, must be called before the first request.
+    void set_placeholder(const sdl_texture_t& texture) {
+        placeholder = texture;
+        owner->placeholder_texture = placeholder;
+        placeholder_created = true;
+    }
+
+    void set_upload_budget(int budget) {
+        upload_budget = budget;
+    }
+
+
+    // == get / has ==
+
+    int get_pending_count() const {
+        return in_flight;
+    }
+
+    bool has_pending() const {
+        return in_flight != 0;
+    }
+
+
+    // == service ==
+
+    void on_frame(sdl_tick_t tick) override {
+        if (mutex == nullptr) {
+            return;
+        }
+
+        int uploads = 0;
+
+        SDL_LockMutex(mutex);
+        while (done.empty() == false && uploads < upload_budget) {
+            job_t* job = done.front();
+            done.pop_front();
+            SDL_UnlockMutex(mutex);
+
+            if (is_texture(job->kind)) {
+                uploads++;
+            }
+            finish(job);
+
+            SDL_LockMutex(mutex);
+        }
+        bool more = done.empty() == false;
+        SDL_UnlockMutex(mutex);
+
+        if (more) {
+            owner->post_wake();
+        }
+    }
+};
+
+
+
+
+// == text pipeline ==
+
+// render texts by jobs, on the loader of it, so texts and files share the workers and the upload budget.
+// workers open the font again from its file, with the style, hinting, outline and kerning it has at request().
+// request() return a text texture at once, it has_pending() and draw the placeholder until uploaded.
+//
+//     sdl_text_pipeline_t texts{this};
+//     lines.push_back(texts.request(font, line));
+class sdl_text_pipeline_t : public sdl_loader_t {
+public:
+    // == init ==
+
+    sdl_text_pipeline_t(sdl_window_t* owner, int upload_budget = 8) : sdl_loader_t(owner, upload_budget) {}
+
+
+    // == request ==
+
+    using sdl_loader_t::request;
+
+    sdl_texture_t request(
+                const sdl_font_t& font, const std::string& text, sdl_render_text_mode_t mode = SDLAPP_TEXT_BLENDED,
+                SDL_Color fg = SDLAPP_COLOR_WHITE, SDL_Color bg = SDLAPP_COLOR_BLACK, uint32_t warp_length = 0
+    ) {
+        return request_text(font, text, mode, fg, bg, warp_length);
+    }
+};
+
+
+
+
+// == resource cache ==
+
+// share one texture / font / music / chunk for same (type, file, parameters).
+// when loaded resources use more than budget bytes, least recently used ones are released at frame start.
+// only resources referenced by nothing but the cache are released, and never music or chunks still playing.
+// a resource counts as used when got, and every frame something out of the cache holds it.
+// released resources are loaded again when next got.
+//
+//     sdl_resource_cache_t cache{this, 64 << 20};
+//     sdl_texture_t sheet = cache.get_texture("titi.png");
+class sdl_resource_cache_t : public sdl_service_t {
+    enum kind_t {
+        KIND_TEXTURE,
+        KIND_FONT,
+        KIND_MUSIC,
+        KIND_CHUNK,
+    };
+
+    class entry_t {
+    public:
+        std::string key;
+        kind_t kind;
+        std::unique_ptr<sdl_resource_t> handle;
+        size_t file_size = 0;       // memory guess of font and music
+        bool file_measured = false;
+    };
+
+    using iterator_t = std::list<entry_t>::iterator;
+
+
+    sdl_window_t* owner;
+    size_t budget;
+
+    std::list<entry_t> lru;         // front is the latest
+    std::list<entry_t> used;        // reused by touch()
+    std::unordered_map<std::string, iterator_t> entries;
+
+
+
+    // in mounted packs or on disk, as they are loaded
+    static size_t get_file_size(const std::string& file) {
+        SDL_RWops* rw = sdl_open_rw(file);
+        if (rw == nullptr) {
+            return 0;
+        }
+        Sint64 size = SDL_RWsize(rw);
+        SDL_RWclose(rw);
+        return size > 0 ? (size_t) size : 0;
+    }
+
+    static size_t get_memory_size(const entry_t& entry) {
+        if (entry.handle->has_loaded() == false) {
+            return 0;
+        }
+        if (entry.kind == KIND_TEXTURE) {
+            sdl_texture_t::texture_info_t* info = (sdl_texture_t::texture_info_t*) entry.handle->ptr;
+            return (size_t) info->width * info->height * 4;
+        }
+        if (entry.kind == KIND_CHUNK) {
+            return ((sdl_chunk_t*) entry.handle.get())->get_size();
+        }
+        return entry.file_size;
+    }
+
+    static bool is_referenced(const entry_t& entry) {
+        return entry.handle->ptr->use_count.load(std::memory_order_relaxed) > 1;
+    }
+
+    static bool is_playing(const entry_t& entry) {
+        switch (entry.kind) {
+            case KIND_MUSIC:    return ((sdl_music_t*) entry.handle.get())->is_playing();
+            case KIND_CHUNK:    return ((sdl_chunk_t*) entry.handle.get())->is_playing();
+            default:            return false;
+        }
+    }
+
+    // make entries held out of the cache the latest, keeping their order
+    void touch() {
+        for (auto it = lru.begin(); it != lru.end();) {
+            auto next = std::next(it);
+            if (is_referenced(*it)) {
+                used.splice(used.end(), lru, it);
+            }
+            it = next;
+        }
+        lru.splice(lru.begin(), used);
+    }
+
+    // find the entry and make it the latest, or create it by make()
+    template <typename make_t>
+    entry_t& get_entry(const std::string& key, kind_t kind, make_t make) {
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            lru.splice(lru.begin(), lru, it->second);
+            return *it->second;
+        }
+
+        lru.emplace_front();
+        entry_t& entry = lru.front();
+        entry.key = key;
+        entry.kind = kind;
+        entry.handle.reset(make());
+        entries[key] = lru.begin();
+        return entry;
+    }
+
+
+public:
+    // == init ==
+
+    sdl_resource_cache_t(sdl_window_t* owner, size_t budget = (size_t) 256 << 20) : owner(owner), budget(budget) {
+        owner->attach_service(this);
+    }
+
+    ~sdl_resource_cache_t() {
+        owner->detach_service(this);
+    }
+
+    sdl_resource_cache_t(const sdl_resource_cache_t&) = delete;
+    sdl_resource_cache_t& operator=(const sdl_resource_cache_t&) = delete;
+
+
+    // == get ==
+
+    sdl_texture_t get_texture(const std::string& file) {
+        entry_t& entry = get_entry("t:" + file, KIND_TEXTURE, [&]() {
+            return new sdl_texture_t(owner, file);
+        });
+        return *(sdl_texture_t*) entry.handle.get();
+    }
+
+    sdl_font_t get_font(const std::string& file, int ptsize) {
+        entry_t& entry = get_entry("f:" + std::to_string(ptsize) + ":" + file, KIND_FONT, [&]() {
+            return new sdl_font_t(file, ptsize);
+        });
+        if (entry.file_measured == false) {
+            entry.file_size = get_file_size(file);
+            entry.file_measured = true;
+        }
+        return *(sdl_font_t*) entry.handle.get();
+    }
+
+    sdl_music_t get_music(const std::string& file) {
+        entry_t& entry = get_entry("m:" + file, KIND_MUSIC, [&]() {
+            return new sdl_music_t(file);
+        });
+        if (entry.file_measured == false) {
+            entry.file_size = get_file_size(file);
+            entry.file_measured = true;
+        }
+        return *(sdl_music_t*) entry.handle.get();
+    }
+
+    sdl_chunk_t get_chunk(const std::string& file) {
+        entry_t& entry = get_entry("c:" + file, KIND_CHUNK, [&]() {
+            return new sdl_chunk_t(file);
+        });
+        return *(sdl_chunk_t*) entry.handle.get();
+    }
+
+    // bytes of loaded resources, textures are counted as 4 bytes a pixel
+    size_t get_memory_usage() const {
+        size_t total = 0;
+        for (const entry_t& entry : lru) {
+            total += get_memory_size(entry);
+        }
+        return total;
+    }
+
+    int get_entry_count() const {
+        return (int) lru.size();
+    }
+
+
+    // == set ==
+
+    void set_budget(size_t bytes) {
+        budget = bytes;
+    }
+
+
+    // == trim / clear ==
+
+    // release least recently used resources until under budget, or nothing left to release
+    void trim() {
+        size_t usage = get_memory_usage();
+
+        for (auto it = lru.rbegin(); it != lru.rend() && usage > budget; ++it) {
+            sdl_resource_t& handle = *it->handle;
+            if (handle.has_pending() || is_referenced(*it) || is_playing(*it)) {
+                continue;
+            }
+
+            size_t size = get_memory_size(*it);
+            if (size == 0) {
+                continue;
+            }
+
+            handle.release();
+            usage -= size;
+        }
+    }
+
+    // forget all entries, resources still referenced stay alive
+    void clear() {
+        entries.clear();
+        lru.clear();
+    }
+
+
+    // == service ==
+
+    void on_frame(sdl_tick_t tick) override {
+        touch();
+        trim();
+    }
+};
+
+
+
+
+
+// == layer ==
+
+// retained content drawn once into a target texture, then composited by one copy every frame.
+// it is drawn again only after invalidate(), a resize of the window (when it follows window size),
+// or the render targets reset.
+//
+//     sdl_layer_t background{this};
+//
+//     void on_render(sdl_tick_t tick) {
+//         if (background.begin()) {
+//             render_copy(renderer, img_titi);
+//             background.end();
+//         }
+//         background.render();
+//     }
+class sdl_layer_t {
+    sdl_window_t* owner;
+    sdl_texture_t texture;
+    int width;                  // 0 means the window width
+    int height;                 // 0 means the window height
+    SDL_Color clear_color;
+
+    bool dirty = true;
+    uint32_t reset_count = 0;
+
+    // saved by begin() and restored by end()
+    bool drawing = false;
+    SDL_Texture* last_target = nullptr;
+    SDL_Rect last_clip = {0, 0, 0, 0};
+    bool last_clip_enabled = false;
+
+
+    int get_target_width() const {
+        return width > 0 ? width : owner->window_width;
+    }
+
+    int get_target_height() const {
+        return height > 0 ? height : owner->window_height;
+    }
+
+
+public:
+    // == init ==
+
+    sdl_layer_t(sdl_window_t* owner, int width = 0, int height = 0, SDL_Color clear_color = {0, 0, 0, 0})
+    : owner(owner), texture(owner), width(width), height(height), clear_color(clear_color) {}
+
+    sdl_layer_t(const sdl_layer_t&) = delete;
+    sdl_layer_t& operator=(const sdl_layer_t&) = delete;
+
+
+    // == draw ==
+
+    // set the layer as render target and clear it if it need to redraw, else return false.
+    // call end() after drawing.
+    bool begin() {
+        if (is_dirty() == false) {
+            return false;
+        }
+
+        int w = get_target_width();
+        int h = get_target_height();
+        if (w <= 0 || h <= 0) {
+            return false;
+        }
+
+        if (texture.has_loaded() == false || texture.get_width() != w || texture.get_height() != h) {
+            texture = sdl_texture_t(owner, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, w, h);
+            texture.load();
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        }
+
+        SDL_Renderer* renderer = owner->renderer;
+
+        last_target = SDL_GetRenderTarget(renderer);
+        last_clip_enabled = SDL_RenderIsClipEnabled(renderer);
+        SDL_RenderGetClipRect(renderer, &last_clip);
+
+        sdl_basic_t::set_render_target(renderer, texture);
+        SDL_RenderSetClipRect(renderer, nullptr);
+
+        SDL_Color color;
+        SDL_GetRenderDrawColor(renderer, &color.r, &color.g, &color.b, &color.a);
+        sdl_basic_t::set_render_draw_color(renderer, clear_color);
+        SDL_RenderClear(renderer);
+        sdl_basic_t::set_render_draw_color(renderer, color);
+
+        drawing = true;
+        return true;
+    }
+
+    // restore the render target, the layer is valid until next invalidate()
+    void end() {
+        if (drawing == false) {
+            return;
+        }
+
+        sdl_basic_t::set_render_target(owner->renderer, last_target);
+        SDL_RenderSetClipRect(owner->renderer, last_clip_enabled ? &last_clip : nullptr);
+
+        drawing = false;
+        dirty = false;
+        reset_count = owner->render_reset_count;
+    }
+
+    // copy the layer to dest_rect, or the whole target if nullptr
+    int render(const SDL_FRect* dest_rect = nullptr) const {
+        if (texture.has_loaded() == false) {
+            return 0;
+        }
+        return sdl_basic_t::render_copy(owner->renderer, texture, nullptr, dest_rect);
+    }
+
+    // draw it by draw() if needed, then copy
+    int render(const std::function<void()>& draw, const SDL_FRect* dest_rect = nullptr) {
+        if (begin()) {
+            draw();
+            end();
+        }
+        return render(dest_rect);
+    }
+
+
+    // == set / get / is ==
+
+    inline void invalidate() {
+        dirty = true;
+    }
+
+    bool is_dirty() const {
+        if (dirty || reset_count != owner->render_reset_count || texture.has_loaded() == false) {
+            return true;
+        }
+        return texture.get_width() != get_target_width() || texture.get_height() != get_target_height();
+    }
+
+    // 0 means follow the window size
+    void set_size(int width, int height) {
+        this->width = width;
+        this->height = height;
+    }
+
+    void set_clear_color(SDL_Color color) {
+        clear_color = color;
+        dirty = true;
+    }
+
+    const sdl_texture_t& get_texture() const {
+        return texture;
+    }
+
+
+    // == release ==
+
+    void release() {
+        texture = sdl_texture_t(owner);
+        dirty = true;
+    }
+};
+
+
+
+
+
+// == atlas ==
+
+// an image packed into a page of sdl_atlas_t, it is a light handle to (atlas, index).
+// it's valid while the atlas alive, and work with render_copy() and sdl_sprite_batch_t::draw().
+class sdl_sub_texture_t {
+    sdl_atlas_t* atlas = nullptr;
+    int index = -1;
+
+public:
+    constexpr sdl_sub_texture_t() {}
+    constexpr sdl_sub_texture_t(sdl_atlas_t* atlas, int index) : atlas(atlas), index(index) {}
+
+
+    // == get ==
+
+    // the page texture
+    operator SDL_Texture*() const;
+
+    // area on the page texture
+    const SDL_Rect& get_rect() const;
+
+    int get_width() const {
+        return get_rect().w;
+    }
+
+    int get_height() const {
+        return get_rect().h;
+    }
+
+    int get_page() const;
+};
+
+
+
+// pack many small images into few large textures (pages) by skyline bottom-left.
+// images are loaded and packed when first to use a sub texture, or when build() called.
+//
+//     sdl_atlas_t icons{this};
+//     sdl_sub_texture_t icon_titi = icons.add("titi.png");
+class sdl_atlas_t {
+    class entry_t {
+    public:
+        std::string file;
+        sdl_surface_t surface;
+        int page = 0;
+        SDL_Rect rect{0, 0, 0, 0};
+
+        entry_t(const std::string& file) : file(file) {}
+        entry_t(const sdl_surface_t& surface) : surface(surface) {}
+    };
+
+    class skyline_t {
+    public:
+        int x, y, w;
+    };
+
+    class page_t {
+    public:
+        std::vector<skyline_t> skyline;
+        SDL_Surface* surface = nullptr;
+        sdl_texture_t texture;
+
+        page_t(sdl_window_t* owner, int size) : skyline{{0, 0, size}}, texture(owner) {}
+    };
+
+
+    sdl_window_t* owner;
+    int page_size;
+    int padding;
+
+    std::vector<entry_t> entries;
+    std::vector<page_t> pages;
+    bool built = false;
+
+
+
+    // == skyline ==
+
+    // return y of placing w x h at skyline[i], or -1 if not fit
+    int fit(const page_t& page, size_t i, int w, int h) const {
+        int x = page.skyline[i].x;
+        if (x + w > page_size) {
+            return -1;
+        }
+
+        int y = 0;
+        int left = w;
+        for (; left > 0; i++) {
+            if (i == page.skyline.size()) {
+                return -1;
+            }
+            y = SDL_max(y, page.skyline[i].y);
+            if (y + h > page_size) {
+                return -1;
+            }
+            left -= page.skyline[i].w;
+        }
+        return y;
+    }
+
+    bool insert(page_t& page, int w, int h, SDL_Point& pos) const {
+        int best_y = page_size + 1;
+        int best_w = page_size + 1;
+        size_t best = page.skyline.size();
+
+        for (size_t i = 0; i < page.skyline.size(); i++) {
+            int y = fit(page, i, w, h);
+            if (y < 0) {
+                continue;
+            }
+            if (y + h < best_y || (y + h == best_y && page.skyline[i].w < best_w)) {
+                best = i;
+                best_y = y + h;
+                best_w = page.skyline[i].w;
+            }
+        }
+        if (best == page.skyline.size()) {
+            return false;
+        }
+
+        pos = {page.skyline[best].x, best_y - h};
+
+        std::vector<skyline_t>& line = page.skyline;
+        line.insert(line.begin() + best, skyline_t{pos.x, best_y, w});
+
+        // shrink or remove the segments covered by the new one
+        for (size_t i = best + 1; i < line.size(); i++) {
+            int end = line[i - 1].x + line[i - 1].w;
+            if (line[i].x >= end) {
+                break;
+            }
+
+            int shrink = end - line[i].x;
+            line[i].x += shrink;
+            line[i].w -= shrink;
+            if (line[i].w > 0) {
+                break;
+            }
+            line.erase(line.begin() + i);
+            i--;
+        }
+
+        // merge segments of same height
+        for (size_t i = 0; i + 1 < line.size(); i++) {
+            if (line[i].y == line[i + 1].y) {
+                line[i].w += line[i + 1].w;
+                line.erase(line.begin() + i + 1);
+                i--;
+            }
+        }
+        return true;
+    }
+
+
+    // == build ==
+
+    SDL_Surface* load_entry(entry_t& entry) const {
+        SDL_Surface* src = entry.file.empty() ? (SDL_Surface*) entry.surface : sdl_load_surface(entry.file);
+        if (src == nullptr) {
+            throw sdl_exception_t("failed to load atlas image '%s', maybe the file not exist!", entry.file.c_str());
+        }
+
+        SDL_Surface* converted = SDL_ConvertSurfaceFormat(src, SDL_PIXELFORMAT_ARGB8888, 0);
+        if (entry.file.empty() == false) {
+            SDL_FreeSurface(src);
+        }
+        if (converted == nullptr) {
+            throw sdl_exception_t("failed to convert atlas image since %s!", SDL_GetError());
+        }
+
+        SDL_SetSurfaceBlendMode(converted, SDL_BLENDMODE_NONE);     // copy alpha as it is
+        return converted;
+    }
+
+
+public:
+    // == delete ==
+
+    ~sdl_atlas_t() {
+        release();
+    }
+
+
+    // == init ==
+
+    sdl_atlas_t(sdl_window_t* owner, int page_size = 1024, int padding = 1)
+    : owner(owner), page_size(page_size), padding(padding) {}
+
+    sdl_atlas_t(const sdl_atlas_t&) = delete;
+    sdl_atlas_t& operator=(const sdl_atlas_t&) = delete;
+
+
+    // == add ==
+
+    // add after build() cause packing again at next use, handles keep valid.
+    sdl_sub_texture_t add(const std::string& file) {
+        entries.emplace_back(file);
+        built = false;
+        return sdl_sub_texture_t(this, (int) entries.size() - 1);
+    }
+
+    sdl_sub_texture_t add(const sdl_surface_t& surface) {
+        entries.emplace_back(surface);
+        built = false;
+        return sdl_sub_texture_t(this, (int) entries.size() - 1);
+    }
+
+
+    // == build / release ==
+
+    void build() {
+        if (built) {
+            return;
+        }
+        if (owner->renderer == nullptr) {
+            throw sdl_exception_t("failed to build atlas since renderer still not created!");
+        }
+        release();
+
+        std::vector<SDL_Surface*> surfaces(entries.size(), nullptr);
+        std::vector<int> order(entries.size());
+
+        try {
+            for (size_t i = 0; i < entries.size(); i++) {
+                surfaces[i] = load_entry(entries[i]);
+                order[i] = (int) i;
+
+                if (surfaces[i]->w + padding > page_size || surfaces[i]->h + padding > page_size) {
+                    throw sdl_exception_t("atlas image %d (%dx%d) is larger than page size %d!",
+                                (int) i, surfaces[i]->w, surfaces[i]->h, page_size
+                    );
+                }
+            }
+
+            // tall images first
+            std::sort(order.begin(), order.end(), [&](int a, int b) {
+                if (surfaces[a]->h != surfaces[b]->h) {
+                    return surfaces[a]->h > surfaces[b]->h;
+                }
+                return surfaces[a]->w > surfaces[b]->w;
+            });
+
+            for (int i : order) {
+                entry_t& entry = entries[i];
+                int w = surfaces[i]->w, h = surfaces[i]->h;
+                SDL_Point pos;
+
+                size_t p = 0;
+                for (; p < pages.size(); p++) {
+                    if (insert(pages[p], w + padding, h + padding, pos)) {
+                        break;
+                    }
+                }
+                if (p == pages.size()) {
+                    pages.emplace_back(owner, page_size);
+                    pages[p].surface = SDL_CreateRGBSurfaceWithFormat(0, page_size, page_size, 32, SDL_PIXELFORMAT_ARGB8888);
+                    if (pages[p].surface == nullptr) {
+                        throw sdl_exception_t("failed to create atlas page since %s!", SDL_GetError());
+                    }
+                    SDL_FillRect(pages[p].surface, nullptr, 0);
+                    insert(pages[p], w + padding, h + padding, pos);
+                }
+
+                entry.page = (int) p;
+                entry.rect = {pos.x, pos.y, w, h};
+                SDL_BlitSurface(surfaces[i], nullptr, pages[p].surface, &entry.rect);
+                entry.rect.w = w;       // blit may clip the rect
+                entry.rect.h = h;
+            }
+        }
+        catch (...) {
+            for (SDL_Surface* surface : surfaces) {
+                SDL_FreeSurface(surface);
+            }
+            throw;
+        }
+
+        for (SDL_Surface* surface : surfaces) {
+            SDL_FreeSurface(surface);
+        }
+
+        for (page_t& page : pages) {
+            SDL_Texture* texture = SDL_CreateTextureFromSurface(owner->renderer, page.surface);
+            SDL_FreeSurface(page.surface);
+            page.surface = nullptr;
+
+            if (texture == nullptr) {
+                throw sdl_exception_t("failed to create atlas page texture since %s!", SDL_GetError());
+            }
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+            page.texture = sdl_texture_t(owner, texture);
+        }
+
+        built = true;
+    }
+
+    void release() {
+        for (page_t& page : pages) {
+            if (page.surface) {
+                SDL_FreeSurface(page.surface);
+            }
+        }
+        pages.clear();
+        built = false;
+    }
+
+
+    // == get ==
+
+    int get_page_count() {
+        build();
+        return (int) pages.size();
+    }
+
+    const sdl_texture_t& get_page(int page) {
+        build();
+        return pages.at(page).texture;
+    }
+
+    const SDL_Rect& get_rect(int index) {
+        build();
+        return entries.at(index).rect;
+    }
+
+    int get_entry_page(int index) {
+        build();
+        return entries.at(index).page;
+    }
+};
+
+
+
+inline sdl_sub_texture_t::operator SDL_Texture*() const {
+    if (atlas == nullptr) {
+        return nullptr;
+    }
+    return atlas->get_page(atlas->get_entry_page(index));
+}
+
+inline const SDL_Rect& sdl_sub_texture_t::get_rect() const {
+    static const SDL_Rect empty{0, 0, 0, 0};
+    return atlas ? atlas->get_rect(index) : empty;
+}
+
+inline int sdl_sub_texture_t::get_page() const {
+    return atlas ? atlas->get_entry_page(index) : -1;
+}
+
+
+inline int sdl_basic_t::render_copy(SDL_Renderer* renderer, const sdl_sub_texture_t& texture,
+            const SDL_Rect* src_rect, const SDL_FRect* dest_rect,
+            double angle, const SDL_FPoint* center, SDL_RendererFlip flip
+) {
+    SDL_Rect rect = texture.get_rect();
+    if (src_rect) {
+        rect = {rect.x + src_rect->x, rect.y + src_rect->y, src_rect->w, src_rect->h};
+    }
+    return SDL_RenderCopyExF(renderer, texture, &rect, dest_rect, angle, center, flip);
+}
+
+inline void sdl_sprite_batch_t::draw(const sdl_sub_texture_t& texture, const SDL_Rect* src_rect, const SDL_FRect& dest_rect,
+            double angle, const SDL_FPoint* center, SDL_RendererFlip flip, SDL_Color color
+) {
+    SDL_Rect rect = texture.get_rect();
+    if (src_rect) {
+        rect = {rect.x + src_rect->x, rect.y + src_rect->y, src_rect->w, src_rect->h};
+    }
+    draw((SDL_Texture*) texture, &rect, dest_rect, angle, center, flip, color);
+}
+
+
+
+
+// == glyph cache ==
+
+// rasterize each glyph once into page textures, then draw text as quads by sdl_sprite_batch_t.
+// SOLID and BLENDED glyphs are rasterized in white and tinted by fg when drawing,
+// SHADED glyphs bake fg / bg in, so they are cached per color.
+// drawing a text of seen glyphs doesn't allocate or upload anything.
+//
+//     sdl_glyph_cache_t glyphs{this};
+//     glyphs.draw(batch, font, "score: 100", 10, 10);
+//     batch.flush(renderer);
+class sdl_glyph_cache_t {
+    class key_t {
     public:
-        sdl_surface_t surface;
+        TTF_Font* font;
+        uint32_t codepoint;
+        uint32_t mode;
+        uint32_t fg;        // fg and bg of shaded glyphs, 0 for others
+        uint32_t bg;
+
+        bool operator==(const key_t& other) const {
+            return font == other.font && codepoint == other.codepoint && mode == other.mode && fg == other.fg && bg == other.bg;
+        }
+    };
 
-        surface_info_t(
-                    sdl_window_t* owner, const sdl_surface_t& surface
-        ):
-        texture_info_t(nullptr, 1, owner, surface.get_width(), surface.get_height()), surface(surface) {}
+    class hash_t {
+    public:
+        size_t operator()(const key_t& key) const {
+            size_t h = std::hash<void*>()(key.font);
+            h ^= (size_t) key.codepoint * 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+            h ^= (size_t) (key.mode | (uint64_t) key.fg << 8) * 0xc2b2ae3d27d4eb4full + (h << 6) + (h >> 2);
+            h ^= (size_t) key.bg * 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+            return h;
+        }
     };
 
+    class glyph_t {
+    public:
+        SDL_Texture* page = nullptr;
+        SDL_Rect rect{0, 0, 0, 0};
+        int advance = 0;
+    };
 
-    class empty_info_t : public texture_info_t {
+    class placed_t {
     public:
-        SDL_PixelFormatEnum format;
-        SDL_TextureAccess access;
-        
-        empty_info_t(
-                sdl_window_t* owner, SDL_PixelFormatEnum format, SDL_TextureAccess access,
-                int width, int height
-        ):
-        texture_info_t(nullptr, 2, owner, width, height), format(format), access(access) {}
+        const glyph_t* glyph;
+        float x, y;
     };
 
-    
-    class render_info_t : public texture_info_t {
+    // shelf packer, glyphs of a font have similar height
+    class page_t {
     public:
-        sdl_font_t font;
-        SDL_Color fg;
-        SDL_Color bg;
-        uint32_t warp_length;
+        sdl_texture_t texture;
+        int x = 0;
+        int y = 0;
+        int shelf_height = 0;
+
+        page_t(const sdl_texture_t& texture) : texture(texture) {}
+    };
+
+
+    sdl_window_t* owner;
+    int page_size;
+
+    std::unordered_map<key_t, glyph_t, hash_t> glyphs;
+    std::vector<page_t> pages;
+    std::vector<placed_t> layout;
+    sdl_sprite_batch_t batch;       // for render()
+
+    int upload_count = 0;
+
+
+
+    // == utf8 ==
+
+    static uint32_t next_codepoint(const char*& p, const char* end) {
+        uint8_t c = (uint8_t) *p++;
+        int extra = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+        uint32_t cp = extra ? c & (0x3f >> extra) : c;
+
+        for (; extra > 0 && p < end; extra--) {
+            if (((uint8_t) *p & 0xc0) != 0x80) {
+                return 0xfffd;
+            }
+            cp = (cp << 6) | ((uint8_t) *p++ & 0x3f);
+        }
+        return extra ? 0xfffd : cp;
+    }
+
+
+    // == page ==
+
+    bool place(page_t& page, int w, int h, SDL_Point& pos) {
+        if (page.x + w > page_size) {
+            page.x = 0;
+            page.y += page.shelf_height + 1;
+            page.shelf_height = 0;
+        }
+        if (page.y + h > page_size || w > page_size) {
+            return false;
+        }
+
+        pos = {page.x, page.y};
+        page.x += w + 1;
+        page.shelf_height = SDL_max(page.shelf_height, h);
+        return true;
+    }
+
+    page_t& new_page() {
+        sdl_texture_t texture(owner, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, page_size, page_size);
+
+        std::vector<uint32_t> zero((size_t) page_size * page_size, 0);
+        SDL_UpdateTexture(texture, nullptr, zero.data(), page_size * sizeof(uint32_t));
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+        pages.emplace_back(texture);
+        return pages.back();
+    }
+
+    glyph_t rasterize(TTF_Font* font, uint32_t codepoint, sdl_render_text_mode_t mode, SDL_Color fg, SDL_Color bg) {
+        glyph_t glyph;
+
+        int minx, maxx, miny, maxy;
+        if (TTF_GlyphMetrics32(font, codepoint, &minx, &maxx, &miny, &maxy, &glyph.advance) != 0) {
+            glyph.advance = 0;
+        }
+
+        SDL_Surface* surface = nullptr;
+        switch (mode) {
+            case SDLAPP_TEXT_SOLID:
+                surface = TTF_RenderGlyph32_Solid(font, codepoint, SDLAPP_COLOR_WHITE);
+                break;
+            case SDLAPP_TEXT_BLENDED:
+                surface = TTF_RenderGlyph32_Blended(font, codepoint, SDLAPP_COLOR_WHITE);
+                break;
+            case SDLAPP_TEXT_SHADED:
+                surface = TTF_RenderGlyph32_Shaded(font, codepoint, fg, bg);
+                break;
+            default:
+                throw sdl_exception_t("invalid text render mode %d!", mode);
+        }
+        if (surface == nullptr) {
+            return glyph;       // nothing to draw, such as space in some fonts
+        }
+
+        SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+        SDL_FreeSurface(surface);
+        if (converted == nullptr) {
+            throw sdl_exception_t("failed to convert glyph surface since %s!", SDL_GetError());
+        }
+
+        SDL_Point pos;
+        if (pages.empty() || place(pages.back(), converted->w, converted->h, pos) == false) {
+            if (place(new_page(), converted->w, converted->h, pos) == false) {
+                SDL_FreeSurface(converted);
+                throw sdl_exception_t("glyph %u is larger than glyph page size %d!", codepoint, page_size);
+            }
+        }
+
+        glyph.page = pages.back().texture;
+        glyph.rect = {pos.x, pos.y, converted->w, converted->h};
+
+        SDL_LockSurface(converted);
+        SDL_UpdateTexture(glyph.page, &glyph.rect, converted->pixels, converted->pitch);
+        SDL_UnlockSurface(converted);
+        SDL_FreeSurface(converted);
+
+        upload_count++;
+        return glyph;
+    }
+
+    const glyph_t& get_glyph(TTF_Font* font, uint32_t codepoint, sdl_render_text_mode_t mode, SDL_Color fg, SDL_Color bg) {
+        key_t key{font, codepoint, (uint32_t) mode, 0, 0};
+        if (mode == SDLAPP_TEXT_SHADED) {
+            key.fg = (uint32_t) fg.r << 24 | fg.g << 16 | fg.b << 8 | fg.a;
+            key.bg = (uint32_t) bg.r << 24 | bg.g << 16 | bg.b << 8 | bg.a;
+        }
+
+        auto it = glyphs.find(key);
+        if (it != glyphs.end()) {
+            return it->second;
+        }
+        // shaded glyph bake fg and bg in and draw in white, others are white and tinted by fg
+        return glyphs.emplace(key, rasterize(font, codepoint, mode, fg, bg)).first->second;
+    }
+
+
+    // == layout ==
+
+    // fill layout, wrap by words and kern like TTF_RenderUTF8_*_Wrapped(), return the size
+    SDL_FPoint lay_out(TTF_Font* font, const std::string& text, sdl_render_text_mode_t mode,
+                SDL_Color fg, SDL_Color bg, uint32_t warp_length
+    ) {
+        const float skip = (float) TTF_FontLineSkip(font);
+        const float warp = (float) warp_length;
+        const bool kerning = TTF_GetFontKerning(font) != 0;
+
+        layout.clear();
+
+        float pen = 0.0f, line_y = 0.0f, width = 0.0f;
+        size_t line_start = 0;
+        size_t last_space = (size_t) -1;
+        uint32_t prev = 0;          // codepoint before on the line, 0 at line start
+
+        const char* p = text.data();
+        const char* end = p + text.size();
+
+        while (p < end) {
+            uint32_t cp = next_codepoint(p, end);
+
+            if (cp == '\n') {
+                width = SDL_max(width, pen);
+                pen = 0.0f;
+                line_y += skip;
+                line_start = layout.size();
+                last_space = (size_t) -1;
+                prev = 0;
+                continue;
+            }
+
+            const glyph_t& glyph = get_glyph(font, cp, mode, fg, bg);
+            float kern = kerning && prev ? (float) TTF_GetFontKerningSizeGlyphs32(font, prev, cp) : 0.0f;
+
+            if (warp_length && pen + kern + glyph.advance > warp && layout.size() > line_start) {
+                if (cp == ' ') {
+                    width = SDL_max(width, pen);
+                    pen = 0.0f;
+                    line_y += skip;
+                    line_start = layout.size();
+                    last_space = (size_t) -1;
+                    prev = 0;
+                    continue;
+                }
+
+                if (last_space != (size_t) -1 && last_space + 1 < layout.size()) {
+                    // move the last word to next line
+                    float shift = layout[last_space + 1].x;
+                    width = SDL_max(width, layout[last_space].x);
+                    line_y += skip;
+                    for (size_t i = last_space + 1; i < layout.size(); i++) {
+                        layout[i].x -= shift;
+                        layout[i].y = line_y;
+                    }
+                    pen -= shift;
+                    line_start = last_space + 1;
+                }
+                else {
+                    width = SDL_max(width, pen);
+                    pen = 0.0f;
+                    line_y += skip;
+                    line_start = layout.size();
+                    kern = 0.0f;
+                }
+                last_space = (size_t) -1;
+            }
+
+            if (cp == ' ') {
+                last_space = layout.size();
+            }
+            pen += kern;
+            layout.push_back({&glyph, pen, line_y});
+            pen += glyph.advance;
+            prev = cp;
+        }
+
+        width = SDL_max(width, pen);
+        return {width, line_y + (float) TTF_FontHeight(font)};
+    }
+
+
+public:
+    // == init ==
+
+    sdl_glyph_cache_t(sdl_window_t* owner, int page_size = 1024) : owner(owner), page_size(page_size) {}
+
+    sdl_glyph_cache_t(const sdl_glyph_cache_t&) = delete;
+    sdl_glyph_cache_t& operator=(const sdl_glyph_cache_t&) = delete;
+
+
+    // == draw ==
+
+    // put glyph quads of text into batch at (x, y), return the size of text
+    SDL_FPoint draw(sdl_sprite_batch_t& batch, const sdl_font_t& font, const std::string& text, float x, float y,
+                sdl_render_text_mode_t mode = SDLAPP_TEXT_BLENDED,
+                SDL_Color fg = SDLAPP_COLOR_WHITE, SDL_Color bg = SDLAPP_COLOR_BLACK,
+                uint32_t warp_length = 0, float scale = 1.0f
+    ) {
+        SDL_FPoint size = lay_out(font, text, mode, fg, bg, warp_length);
+        SDL_Color color = mode == SDLAPP_TEXT_SHADED ? SDLAPP_COLOR_WHITE : fg;
+
+        for (const placed_t& placed : layout) {
+            const glyph_t& glyph = *placed.glyph;
+            if (glyph.page == nullptr) {
+                continue;
+            }
+
+            SDL_FRect rect{
+                x + placed.x * scale, y + placed.y * scale,
+                (float) glyph.rect.w * scale, (float) glyph.rect.h * scale
+            };
+            batch.draw(glyph.page, &glyph.rect, rect, 0.0, nullptr, SDL_FLIP_NONE, color);
+        }
+        return {size.x * scale, size.y * scale};
+    }
+
+    // draw text immediately
+    SDL_FPoint render(SDL_Renderer* renderer, const sdl_font_t& font, const std::string& text, float x, float y,
+                sdl_render_text_mode_t mode = SDLAPP_TEXT_BLENDED,
+                SDL_Color fg = SDLAPP_COLOR_WHITE, SDL_Color bg = SDLAPP_COLOR_BLACK,
+                uint32_t warp_length = 0, float scale = 1.0f
+    ) {
+        SDL_FPoint size = draw(batch, font, text, x, y, mode, fg, bg, warp_length, scale);
+        batch.flush(renderer);
+        return size;
+    }
+
+    // size of text without drawing, glyphs are still cached
+    SDL_FPoint measure(const sdl_font_t& font, const std::string& text,
+                sdl_render_text_mode_t mode = SDLAPP_TEXT_BLENDED, uint32_t warp_length = 0
+    ) {
+        return lay_out(font, text, mode, SDLAPP_COLOR_WHITE, SDLAPP_COLOR_BLACK, warp_length);
+    }
+
+
+    // == release ==
+
+    // call it after a cached font released, since glyphs are keyed by TTF_Font*
+    void clear() {
+        glyphs.clear();
+        pages.clear();
+        layout.clear();
+        batch.clear();
+    }
+
+
+    // == get ==
+
+    int get_glyph_count() const {
+        return (int) glyphs.size();
+    }
+
+    int get_page_count() const {
+        return (int) pages.size();
+    }
+
+    // glyphs uploaded since created, stay unchanged when drawing seen text
+    int get_upload_count() const {
+        return upload_count;
+    }
+};
+
+
+
+
+
+
+
+// == entity ==
+
+class sdl_entity_t {
+public:
+    class render_info_t {
+    public:
+        SDL_Renderer* renderer;
+        int w_width, w_height;
+        sdl_tick_t tick;
+    };
+
+    float x, y;
+    bool show;
+
+    constexpr sdl_entity_t(float x = 0, float y = 0, bool show = true) : x(x), y(y), show(show) {}
+
+
+    virtual void render(render_info_t& info) const = 0;
+    
+    virtual bool in_point(SDL_FPoint& point) const {
+        return false;
+    }
+
+    virtual bool on_rect(SDL_FRect& rect) const {
+        return false;
+    }
+
+    // area it may draw on, used by sdl_entity_manager_t for culling and queries.
+    // negative w / h means unknown, such entity is never culled.
+    virtual SDL_FRect get_bounds() const {
+        return {x, y, -1.0f, -1.0f};
+    }
+};
+
+
+
+// text drawn at (x, y), the texture is made again only when something changed, at most once a frame.
+// rect.w / rect.h scale the text, keep them 0 to use the size of text.
+class sdl_text_entity_t : public sdl_entity_t {
+    sdl_window_t* owner;
+
+    std::string text;
+    sdl_font_t font;
+    sdl_render_text_mode_t mode;
+    SDL_Color fg, bg;
+    uint32_t warp_length;
+
+    // streaming texture, reused while the text fit in
+    mutable sdl_texture_t texture;
+    mutable int capacity_width = 0;
+    mutable int capacity_height = 0;
+
+    mutable int width = 0;
+    mutable int height = 0;
+    mutable bool dirty = true;
+
+
+
+    void update() const {
+        if (dirty == false) {
+            return;
+        }
+        dirty = false;
+
+        if (text.empty()) {
+            width = height = 0;
+            return;
+        }
+
+        sdl_surface_t surface(font, text, mode, fg, bg, warp_length);
+        SDL_Surface* src = surface;
+        SDL_Surface* converted = nullptr;
+
+        if (src->format->format != SDL_PIXELFORMAT_ARGB8888) {
+            src = converted = SDL_ConvertSurfaceFormat(src, SDL_PIXELFORMAT_ARGB8888, 0);
+            if (converted == nullptr) {
+                throw sdl_exception_t("failed to convert text surface since %s!", SDL_GetError());
+            }
+        }
+
+        if (src->w > capacity_width || src->h > capacity_height) {
+            // grow in steps of 64, so typing don't create texture every frame
+            capacity_width = (SDL_max(src->w, capacity_width) + 63) & ~63;
+            capacity_height = (SDL_max(src->h, capacity_height) + 63) & ~63;
+
+            texture = sdl_texture_t(owner, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, capacity_width, capacity_height);
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        }
+
+        SDL_Rect area{0, 0, src->w, src->h};
+        SDL_UpdateTexture(texture, &area, src->pixels, src->pitch);
+        width = src->w;
+        height = src->h;
+
+        if (converted) {
+            SDL_FreeSurface(converted);
+        }
+    }
+
+
+public:
+    SDL_FRect rect;
+
+
+
+    sdl_text_entity_t(
+                sdl_window_t* owner,
+                sdl_font_t font, const std::string& text,
+                SDL_FRect rect, sdl_render_text_mode_t mode = SDLAPP_TEXT_BLENDED,
+                SDL_Color fg = SDLAPP_COLOR_WHITE, SDL_Color bg = SDLAPP_COLOR_WHITE,
+                uint32_t warp_length = 0
+    ):
+    sdl_entity_t(rect.x, rect.y), owner(owner),
+    text(text), font(font), mode(mode), fg(fg), bg(bg), warp_length(warp_length),
+    texture(owner), rect(rect) {}
+
+
+    void render(render_info_t& info) const {
+        if (show == false) {
+            return;
+        }
+
+        update();
+        if (width == 0 || height == 0) {
+            return;
+        }
+
+        SDL_Rect src{0, 0, width, height};
+        SDL_FRect dest = get_rect();
+        SDL_RenderCopyF(info.renderer, texture, &src, &dest);
+    }
+
+    bool in_point(SDL_FPoint& point) const {
+        SDL_FRect dest = get_rect();
+        return show && SDL_PointInFRect(&point, &dest);
+    }
+
+    bool on_rect(SDL_FRect& rect) const {
+        SDL_FRect dest = get_rect();
+        return show && SDL_HasIntersectionF(&dest, &rect);
+    }
+
+    SDL_FRect get_bounds() const {
+        return get_rect();
+    }
+
+
+
+    // == set ==
+
+    void set_text(const std::string& text) {
+        if (this->text != text) {
+            this->text = text;
+            dirty = true;
+        }
+    }
+
+    void set_font(const sdl_font_t& font) {
+        if (this->font != font) {
+            this->font = font;
+            dirty = true;
+        }
+    }
+
+    void set_mode(sdl_render_text_mode_t mode) {
+        if (this->mode != mode) {
+            this->mode = mode;
+            dirty = true;
+        }
+    }
+
+    void set_color(SDL_Color fg, SDL_Color bg = SDLAPP_COLOR_WHITE) {
+        // bg is only used by SHADED
+        if (this->fg != fg || (mode == SDLAPP_TEXT_SHADED && this->bg != bg)) {
+            dirty = true;
+        }
+        this->fg = fg;
+        this->bg = bg;
+    }
+
+    void set_warp_length(uint32_t warp_length) {
+        if (this->warp_length != warp_length) {
+            this->warp_length = warp_length;
+            dirty = true;
+        }
+    }
+
+
+
+    // == get ==
+
+    const std::string& get_text() const {
+        return text;
+    }
 
-        render_info_t(sdl_window_t* owner, sdl_font_t font, const std::string& text, sdl_render_text_mode_t mode,
-                    SDL_Color fg, SDL_Color bg, uint32_t warp_length
-        ):
-        texture_info_t(text, mode, owner), font(font), fg(fg), bg(bg), warp_length(warp_length) {}
-    };
+    const sdl_font_t& get_font() const {
+        return font;
+    }
 
-public:
-    // == delete ==
+    int get_width() const {
+        update();
+        return width;
+    }
 
-    ~sdl_texture_t() {
-        _delete((release_t) SDL_DestroyTexture);
+    int get_height() const {
+        update();
+        return height;
     }
 
+    // where it is drawn
+    SDL_FRect get_rect() const {
+        update();
+        return {x, y, rect.w > 0 ? rect.w : (float) width, rect.h > 0 ? rect.h : (float) height};
+    }
+};
 
-    // == init ==
 
-    sdl_texture_t(sdl_window_t* owner, const std::string& file) : sdl_resource_t(new texture_info_t(file, 0, owner)) {}
-    sdl_texture_t(sdl_window_t* owner, SDL_Texture* texture = nullptr) : sdl_resource_t(new texture_info_t(texture, 0, owner, 0, 0)) {}
 
 
-    sdl_texture_t(sdl_window_t* owner, const sdl_surface_t& surface) : sdl_resource_t(new surface_info_t(owner, surface)) {}
+// == entity manager ==
 
+// keep entities in a uniform grid of cell_size, so rendering only visit entities on the window,
+// and point / rect queries only visit nearby cells.
+// entities are drawn in order of adding. after moving an entity or changing its size, call update(entity).
+// entities without bounds (see sdl_entity_t::get_bounds) are kept out of the grid and visited every time.
+//
+//     sdl_entity_manager_t entities{this};
+//     entities.add(&label);
+//     ...
+//     entities.render(tick);       // in on_render()
+class sdl_entity_manager_t {
+    class entry_t {
+    public:
+        sdl_entity_t* entity = nullptr;
+        uint64_t order = 0;
+        uint32_t stamp = 0;
+        SDL_Rect cells{0, 0, 0, 0};     // covered cells, w / h are the last cell
+        bool bounded = true;
+    };
 
-    sdl_texture_t(
-                sdl_window_t* owner, SDL_PixelFormatEnum format, SDL_TextureAccess access,
-                int width, int height
-    ):
-    sdl_resource_t(new empty_info_t(owner, format, access, width, height)) {}
+    sdl_window_t* owner;
+    float cell_size;
 
+    std::vector<entry_t> entries;
+    std::vector<int> free_entries;
+    std::unordered_map<sdl_entity_t*, int> indices;
+    std::unordered_map<uint64_t, std::vector<int>> cells;
+    std::vector<int> unbounded;
+    std::vector<std::unique_ptr<sdl_entity_t>> owned;
 
-    sdl_texture_t(
-                sdl_window_t* owner,
-                sdl_font_t font, const std::string& text, sdl_render_text_mode_t mode,
-                SDL_Color fg = SDLAPP_COLOR_WHITE, SDL_Color bg = SDLAPP_COLOR_BLACK, uint32_t warp_length = 0
-    ):
-    sdl_resource_t(new render_info_t(owner, font, text, mode, fg, bg, warp_length)) {}
+    uint64_t next_order = 0;
+    uint32_t stamp = 0;
+    std::vector<int> found;        // reused by queries
 
 
-    // == copy ==
 
-    sdl_texture_t(const sdl_texture_t& other) noexcept = default;
+    // == cell ==
 
-    sdl_texture_t& operator=(const sdl_texture_t& other) {
-        if (((texture_info_t*) ptr)->owner != ((texture_info_t*) other.ptr)->owner) {
-            throw std::invalid_argument("couldn't convert texture owned other window!");
-        }
+    static uint64_t get_key(int cx, int cy) {
+        return (uint64_t) (uint32_t) cx << 32 | (uint32_t) cy;
+    }
 
-        _move2((release_t) SDL_DestroyTexture, other);
-        return *this;
+    SDL_Rect get_cells(const SDL_FRect& rect) const {
+        int x0 = (int) std::floor(rect.x / cell_size);
+        int y0 = (int) std::floor(rect.y / cell_size);
+        int x1 = (int) std::floor((rect.x + rect.w) / cell_size);
+        int y1 = (int) std::floor((rect.y + rect.h) / cell_size);
+        return {x0, y0, x1, y1};
     }
-    
 
-    sdl_texture_t(sdl_texture_t&& other) noexcept = default;
+    static void erase_index(std::vector<int>& list, int index) {
+        for (size_t i = 0; i < list.size(); i++) {
+            if (list[i] == index) {
+                list[i] = list.back();
+                list.pop_back();
+                break;
+            }
+        }
+    }
 
-    sdl_texture_t& operator=(sdl_texture_t&& other) {
-        if (((texture_info_t*) ptr)->owner != ((texture_info_t*) other.ptr)->owner) {
-            throw std::invalid_argument("couldn't convert texture owned other window!");
+    void link(int index) {
+        if (entries[index].bounded == false) {
+            unbounded.push_back(index);
+            return;
         }
 
-        _move2((release_t) SDL_DestroyTexture, other);
-        return *this;
+        const SDL_Rect& c = entries[index].cells;
+        for (int cy = c.y; cy <= c.h; cy++) {
+            for (int cx = c.x; cx <= c.w; cx++) {
+                cells[get_key(cx, cy)].push_back(index);
+            }
+        }
     }
-    
 
+    void unlink(int index) {
+        if (entries[index].bounded == false) {
+            erase_index(unbounded, index);
+            return;
+        }
 
-    // == get ==
+        const SDL_Rect& c = entries[index].cells;
+        for (int cy = c.y; cy <= c.h; cy++) {
+            for (int cx = c.x; cx <= c.w; cx++) {
+                auto it = cells.find(get_key(cx, cy));
+                if (it == cells.end()) {
+                    continue;
+                }
 
-    operator SDL_Texture*() const {
-        load();
-        return (SDL_Texture*) ptr->resource;
+                erase_index(it->second, index);
+                if (it->second.empty()) {
+                    cells.erase(it);
+                }
+            }
+        }
     }
 
-    int get_width() const {
-        load();
-        return ((texture_info_t*) ptr)->width;
+    // collect entities whose cells overlap rect into found, sorted by order
+    void collect(const SDL_FRect& rect) {
+        found.clear();
+        if (++stamp == 0) {
+            for (entry_t& entry : entries) {
+                entry.stamp = 0;
+            }
+            stamp = 1;
+        }
+
+        SDL_Rect c = get_cells(rect);
+        for (int cy = c.y; cy <= c.h; cy++) {
+            for (int cx = c.x; cx <= c.w; cx++) {
+                auto it = cells.find(get_key(cx, cy));
+                if (it == cells.end()) {
+                    continue;
+                }
+                for (int index : it->second) {
+                    if (entries[index].stamp != stamp) {
+                        entries[index].stamp = stamp;
+                        found.push_back(index);
+                    }
+                }
+            }
+        }
+        found.insert(found.end(), unbounded.begin(), unbounded.end());
+
+        std::sort(found.begin(), found.end(), [this](int a, int b) {
+            return entries[a].order < entries[b].order;
+        });
     }
 
-    int get_height() const {
-        load();
-        return ((texture_info_t*) ptr)->height;
+    static bool overlap(const SDL_FRect& a, const SDL_FRect& b) {
+        return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h && b.y <= a.y + a.h;
     }
 
 
-    // == load / release ==
+public:
+    // == init ==
 
-    void load() const {
-        if (has_loaded()) {
+    sdl_entity_manager_t(sdl_window_t* owner, float cell_size = 128.0f) : owner(owner), cell_size(cell_size) {}
+
+    sdl_entity_manager_t(const sdl_entity_manager_t&) = delete;
+    sdl_entity_manager_t& operator=(const sdl_entity_manager_t&) = delete;
+
+
+    // == add / remove ==
+
+    // the entity is not owned, it must be removed before destroyed
+    void add(sdl_entity_t* entity) {
+        if (indices.count(entity)) {
             return;
         }
 
-        texture_info_t* basic = (texture_info_t*) ptr;
-
-        if (basic->owner->renderer == nullptr) {
-            throw sdl_exception_t("failed to load texture '%s' since renderer still not created!", ptr->file.c_str());
+        int index;
+        if (free_entries.empty()) {
+            index = (int) entries.size();
+            entries.emplace_back();
+        }
+        else {
+            index = free_entries.back();
+            free_entries.pop_back();
         }
 
+        entry_t& entry = entries[index];
+        entry.entity = entity;
+        entry.order = next_order++;
 
-        if (basic->load_method == 0) {
-            basic->resource = IMG_LoadTexture(basic->owner->renderer, basic->file.c_str());
+        SDL_FRect bounds = entity->get_bounds();
+        entry.bounded = bounds.w >= 0.0f && bounds.h >= 0.0f;
+        entry.cells = entry.bounded ? get_cells(bounds) : SDL_Rect{0, 0, 0, 0};
 
-            if (basic->resource == nullptr) {
-                throw sdl_exception_t("failed to load texture '%s', maybe the file not exist!", basic->file.c_str());
-            }
+        indices[entity] = index;
+        link(index);
+    }
 
-            SDL_QueryTexture((SDL_Texture*)basic->resource, nullptr, nullptr, &basic->width, &basic->height);
-            return;
-        }
-        if (ptr->load_method == 1) {
-            surface_info_t* info = (surface_info_t*) ptr;
-            info->resource = SDL_CreateTextureFromSurface(basic->owner->renderer, info->surface);
+    // make an entity owned by the manager
+    template <typename T, typename... args_t>
+    T* create(args_t&&... args) {
+        T* entity = new T(std::forward<args_t>(args)...);
+        owned.emplace_back(entity);
+        add(entity);
+        return entity;
+    }
 
-            if (info->resource == nullptr) {
-                throw sdl_exception_t("failed to create texture from surface, %s", SDL_GetError());
-            }
-            info->width = info->surface.get_width();
-            info->height = info->surface.get_height();
+    void remove(sdl_entity_t* entity) {
+        auto it = indices.find(entity);
+        if (it == indices.end()) {
             return;
         }
-        if (ptr->load_method == 2) {
-            empty_info_t* info = (empty_info_t*) ptr;
-            info->resource = SDL_CreateTexture(basic->owner->renderer, info->format, info->access, info->width, info->height);
 
-            if (info->resource == nullptr) {
-                throw sdl_exception_t("failed to create texture, %s", SDL_GetError());
+        int index = it->second;
+        unlink(index);
+        entries[index].entity = nullptr;
+        free_entries.push_back(index);
+        indices.erase(it);
+
+        for (size_t i = 0; i < owned.size(); i++) {
+            if (owned[i].get() == entity) {
+                owned[i].swap(owned.back());
+                owned.pop_back();
+                break;
             }
-            return;
         }
-
-        render_info_t* info = (render_info_t*) ptr;
-        sdl_surface_t surface(info->font, info->file, (sdl_render_text_mode_t)info->load_method, info->fg, info->bg, info->warp_length);
-        
-        ptr->resource = SDL_CreateTextureFromSurface(basic->owner->renderer, surface);
-        info->width = surface.get_width();
-        info->height = surface.get_height();
     }
 
-    void release() const {
-        _release((release_t) SDL_DestroyTexture);
+    void clear() {
+        entries.clear();
+        free_entries.clear();
+        indices.clear();
+        cells.clear();
+        unbounded.clear();
+        owned.clear();
     }
-};
 
 
+    // == update ==
 
+    // call it after the entity moved or resized
+    void update(sdl_entity_t* entity) {
+        auto it = indices.find(entity);
+        if (it == indices.end()) {
+            return;
+        }
 
-class sdl_music_t : public sdl_resource_t {
+        entry_t& entry = entries[it->second];
+        SDL_FRect bounds = entity->get_bounds();
+        bool bounded = bounds.w >= 0.0f && bounds.h >= 0.0f;
+        if (bounded == false && entry.bounded == false) {
+            return;
+        }
 
-public:
-    // == delete ==
+        SDL_Rect c = bounded ? get_cells(bounds) : SDL_Rect{0, 0, 0, 0};
+        if (bounded == entry.bounded && c.x == entry.cells.x && c.y == entry.cells.y && c.w == entry.cells.w && c.h == entry.cells.h) {
+            return;
+        }
 
-    ~sdl_music_t() {
-        _delete((release_t)Mix_FreeMusic);
+        unlink(it->second);
+        entry.bounded = bounded;
+        entry.cells = c;
+        link(it->second);
     }
 
+    void move(sdl_entity_t* entity, float x, float y) {
+        entity->x = x;
+        entity->y = y;
+        update(entity);
+    }
 
-    // == init ==
 
-    sdl_music_t(const std::string& file) : sdl_resource_t(new basic_info_t(file)) {}
-    sdl_music_t(Mix_Music* music = nullptr) : sdl_resource_t(new basic_info_t((void*) music)) {}
+    // == render ==
 
+    // render shown entities overlapping the window
+    // only entities in the redraw rect of owner, which is the whole window if not in partial redraw mode
+    void render(sdl_tick_t tick) {
+        sdl_entity_t::render_info_t info{owner->renderer, owner->window_width, owner->window_height, tick};
+        const SDL_Rect& rect = owner->get_redraw_rect();
+        render(info, {(float) rect.x, (float) rect.y, (float) rect.w, (float) rect.h});
+    }
 
-    // == copy / move ==
+    void render(sdl_entity_t::render_info_t& info, const SDL_FRect& view) {
+        collect(view);
+        for (int index : found) {
+            sdl_entity_t* entity = entries[index].entity;
+            if (entity->show && (entries[index].bounded == false || overlap(entity->get_bounds(), view))) {
+                entity->render(info);
+            }
+        }
+    }
 
-    sdl_music_t(const sdl_music_t& other) noexcept = default;
 
-    sdl_music_t& operator=(const sdl_music_t& other) noexcept {
-        _move2((release_t) Mix_FreeMusic, other);
-        return *this;
+    // == query ==
+
+    // the top most entity on point, or nullptr
+    sdl_entity_t* get_entity_at(SDL_FPoint point) {
+        collect({point.x, point.y, 0.0f, 0.0f});
+        for (size_t i = found.size(); i-- > 0;) {
+            sdl_entity_t* entity = entries[found[i]].entity;
+            if (entity->in_point(point)) {
+                return entity;
+            }
+        }
+        return nullptr;
     }
-    
 
-    sdl_music_t(sdl_music_t&& other) noexcept = default;
+    // entities on point, in drawing order
+    void query_point(SDL_FPoint point, std::vector<sdl_entity_t*>& out) {
+        out.clear();
+        collect({point.x, point.y, 0.0f, 0.0f});
+        for (int index : found) {
+            if (entries[index].entity->in_point(point)) {
+                out.push_back(entries[index].entity);
+            }
+        }
+    }
 
-    sdl_music_t& operator=(sdl_music_t&& other) noexcept {
-        _move2((release_t) Mix_FreeMusic, other);
-        return *this;
+    // entities on rect, in drawing order
+    void query_rect(SDL_FRect rect, std::vector<sdl_entity_t*>& out) {
+        out.clear();
+        collect(rect);
+        for (int index : found) {
+            if (entries[index].entity->on_rect(rect)) {
+                out.push_back(entries[index].entity);
+            }
+        }
     }
-    
 
 
     // == get ==
 
-    operator Mix_Music*() const {
-        load();
-        return (Mix_Music*) ptr->resource;
+    int get_entity_count() const {
+        return (int) indices.size();
     }
-    
+};
 
-    // == play ==
 
-    void play(int loops = 0) const {
-        load();
-        if (Mix_PlayMusic((Mix_Music*) ptr->resource, loops) != 0) {
-            throw sdl_exception_t("failed to play music '%s'!", ptr->file.c_str());
-        }
-    }
 
+// == entity array ==
 
-    // == load / release ==
+// structure of arrays storage for many simple sprites, an alternative of virtual sdl_entity_t.
+// each field is a contiguous array, update() and render() walk them linearly without virtual calls,
+// and render() feed sdl_sprite_batch_t in bulk.
+// remove() move the last sprite into the hole, so indices of other sprites may change.
+class sdl_entity_array_t {
+    std::vector<SDL_Texture*> textures;
+    sdl_sprite_batch_t batch;       // for render(renderer)
 
-    void load() const {
-        if (has_loaded()) {
-            return;
-        }
 
-        ptr->resource = Mix_LoadMUS(ptr->file.c_str());
-        if (ptr->resource == nullptr) {
-            throw sdl_exception_t("failed to load music '%s', maybe the file not exist!", ptr->file.c_str());
-        }
+    static int ctz(uint64_t bits) {
+        _CODE_IN_MSVC(unsigned long i; _BitScanForward64(&i, bits); return (int) i;)
+        _CODE_NOT_MSVC(return __builtin_ctzll(bits);)
     }
 
-    void release() const {
-        _release((release_t) Mix_FreeMusic);
+public:
+    std::vector<float> x, y;
+    std::vector<float> w, h;
+    std::vector<float> vx, vy;          // moved by update()
+    std::vector<uint16_t> texture_id;
+    std::vector<SDL_Rect> src_rect;     // w == 0 means whole texture
+    std::vector<uint64_t> visible;      // one bit each
+
+
+
+    // == texture ==
+
+    uint16_t add_texture(SDL_Texture* texture) {
+        for (size_t i = 0; i < textures.size(); i++) {
+            if (textures[i] == texture) {
+                return (uint16_t) i;
+            }
+        }
+        textures.push_back(texture);
+        return (uint16_t) (textures.size() - 1);
     }
-};
 
 
+    // == create / remove ==
 
+    void reserve(size_t count) {
+        x.reserve(count);
+        y.reserve(count);
+        w.reserve(count);
+        h.reserve(count);
+        vx.reserve(count);
+        vy.reserve(count);
+        texture_id.reserve(count);
+        src_rect.reserve(count);
+        visible.reserve((count + 63) / 64);
+    }
 
+    int create(SDL_FRect rect, uint16_t texture, SDL_Rect src = {0, 0, 0, 0}, bool show = true) {
+        size_t i = x.size();
 
+        x.push_back(rect.x);
+        y.push_back(rect.y);
+        w.push_back(rect.w);
+        h.push_back(rect.h);
+        vx.push_back(0.0f);
+        vy.push_back(0.0f);
+        texture_id.push_back(texture);
+        src_rect.push_back(src);
 
+        if (i / 64 >= visible.size()) {
+            visible.push_back(0);
+        }
+        set_show((int) i, show);
+        return (int) i;
+    }
 
-// == entity ==
+    void remove(int index) {
+        size_t last = x.size() - 1;
+        if ((size_t) index != last) {
+            x[index] = x[last];
+            y[index] = y[last];
+            w[index] = w[last];
+            h[index] = h[last];
+            vx[index] = vx[last];
+            vy[index] = vy[last];
+            texture_id[index] = texture_id[last];
+            src_rect[index] = src_rect[last];
+            set_show(index, has_show((int) last));
+        }
 
-class sdl_entity_t {
-protected:
-    class render_info_t {
-    public:
-        SDL_Renderer* renderer;
-        int w_width, w_height;
-        sdl_tick_t tick;
-    };
+        x.pop_back();
+        y.pop_back();
+        w.pop_back();
+        h.pop_back();
+        vx.pop_back();
+        vy.pop_back();
+        texture_id.pop_back();
+        src_rect.pop_back();
+
+        set_show((int) last, false);
+        if (last % 64 == 0) {
+            visible.pop_back();
+        }
+    }
 
-public:
-    float x, y;
-    bool show;
+    void clear() {
+        x.clear();
+        y.clear();
+        w.clear();
+        h.clear();
+        vx.clear();
+        vy.clear();
+        texture_id.clear();
+        src_rect.clear();
+        visible.clear();
+    }
 
-    constexpr sdl_entity_t(float x = 0, float y = 0, bool show = true) : x(x), y(y), show(show) {}
 
+    // == set / has / get ==
 
-    virtual void render(render_info_t& info) const = 0;
-    
-    virtual bool in_point(SDL_FPoint& point) const {
-        return false;
+    void set_show(int index, bool show) {
+        uint64_t bit = (uint64_t) 1 << (index & 63);
+        if (show) {
+            visible[index >> 6] |= bit;
+        }
+        else {
+            visible[index >> 6] &= ~bit;
+        }
     }
 
-    virtual bool on_rect(SDL_FRect& rect) const {
-        return false;
+    bool has_show(int index) const {
+        return (visible[index >> 6] >> (index & 63)) & 1;
     }
-};
 
+    int get_count() const {
+        return (int) x.size();
+    }
 
 
-class sdl_text_entity_t : public sdl_entity_t {
-    sdl_surface_t surface;
-    sdl_texture_t texture;
+    // == system ==
 
-public:
-    sdl_font_t font;
-    SDL_FRect rect;
-    sdl_render_text_mode_t mode;
+    // move all sprites by velocity
+    void update(float dt) {
+        size_t n = x.size();
+        float* px = x.data();
+        float* py = y.data();
+        const float* pvx = vx.data();
+        const float* pvy = vy.data();
 
-    SDL_Color fg, bg;
-    uint32_t warp_length;
+        for (size_t i = 0; i < n; i++) {
+            px[i] += pvx[i] * dt;
+            py[i] += pvy[i] * dt;
+        }
+    }
 
+    // queue shown sprites overlapping view into batch
+    void render(sdl_sprite_batch_t& batch, const SDL_FRect& view) const {
+        const float right = view.x + view.w;
+        const float bottom = view.y + view.h;
 
+        for (size_t word = 0; word < visible.size(); word++) {
+            uint64_t bits = visible[word];
 
-    sdl_text_entity_t(
-                sdl_window_t* owner,
-                sdl_font_t font, const std::string& text,
-                SDL_FRect rect, sdl_render_text_mode_t mode = SDLAPP_TEXT_BLENDED,
-                SDL_Color fg = SDLAPP_COLOR_WHITE, SDL_Color bg = SDLAPP_COLOR_WHITE,
-                uint32_t warp_length = 0
-    ):
-    surface(font, text, mode, fg, bg, warp_length), texture(owner),
-    font(font), rect(rect), mode(mode) {}
+            while (bits) {
+                size_t i = word * 64 + ctz(bits);
+                bits &= bits - 1;
 
+                if (x[i] > right || y[i] > bottom || x[i] + w[i] < view.x || y[i] + h[i] < view.y) {
+                    continue;
+                }
 
-    void render(render_info_t& info) const {
-        
+                const SDL_Rect& src = src_rect[i];
+                batch.draw(textures[texture_id[i]], src.w ? &src : nullptr, SDL_FRect{x[i], y[i], w[i], h[i]});
+            }
+        }
     }
 
-
-    void set_text(const std::string& text) {
-        this->surface = sdl_surface_t(font, text, mode, fg, bg, warp_length);
+    int render(SDL_Renderer* renderer, const SDL_FRect& view) {
+        render(batch, view);
+        return batch.flush(renderer);
     }
 };
-
-
@@ -0,0 +1,50 @@
+// clang++ -std=c++17 sdlpack.cpp -o sdlpack -lsdl2 -lsdl2_ttf -lsdl2_image -lsdl2_mixer
+// pack asset files into one file for sdl_packs().mount():
+//
+//     ./sdlpack assets.pack titi.png fonts/
+//
+// directories are added recursively. names are the paths as given, such as "fonts/PixelMplus10-Regular.ttf",
+// so resources keep using the same names after the pack mounted.
+
+#include "sdlapp2.hpp"
+
+#include <filesystem>
+
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <pack> <file or directory>...\n";
+        return 1;
+    }
+
+    std::vector<std::string> files;
+    for (int i = 2; i < argc; i++) {
+        std::filesystem::path path(argv[i]);
+
+        if (std::filesystem::is_directory(path)) {
+            for (auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+                if (entry.is_regular_file()) {
+                    files.push_back(entry.path().generic_string());
+                }
+            }
+        }
+        else {
+            files.push_back(path.generic_string());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    try {
+        sdl_pack_t::build(argv[1], files);
+    }
+    catch (sdl_exception_t& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    for (const std::string& file : files) {
+        std::cout << file << "\n";
+    }
+    std::cout << files.size() << " files packed into " << argv[1] << "\n";
+    return 0;
+}